@@ -0,0 +1,80 @@
+#include "AllocationCounter.h"
+
+#include <new>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifdef _DEBUG
+
+namespace
+{
+	thread_local uint64_t threadAllocations = 0;
+
+	void* countedAlloc(size_t size)
+	{
+		++threadAllocations;
+
+		void* p = malloc(size ? size : 1);
+		if (p == nullptr)
+			throw std::bad_alloc();
+		return p;
+	}
+
+	void* countedAlignedAlloc(size_t size, std::align_val_t alignment)
+	{
+		++threadAllocations;
+
+		size = size ? size : 1;
+#ifdef _WIN32
+		void* p = _aligned_malloc(size, (size_t)alignment);
+#else
+		// aligned_alloc wants a multiple of the alignment
+		const size_t align = (size_t)alignment;
+		void* p = aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+		if (p == nullptr)
+			throw std::bad_alloc();
+		return p;
+	}
+
+	void alignedFree(void* p)
+	{
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+}
+
+uint64_t AllocationCounter::ThreadAllocations()
+{
+	return threadAllocations;
+}
+
+// The array and nothrow forms are defined by the standard in terms of
+// these, so replacing them counts every new expression
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return countedAlignedAlloc(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return countedAlignedAlloc(size, alignment); }
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { alignedFree(p); }
+
+#else
+
+uint64_t AllocationCounter::ThreadAllocations()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// Debug builds replace the global operator new and count every allocation
+// made by the calling thread.  The audio thread takes a reading before and
+// after a block to prove its steady state does not touch the heap.
+// Release builds keep the default allocator and always read zero.
+namespace AllocationCounter
+{
+	constexpr bool Enabled =
+#ifdef _DEBUG
+		true;
+#else
+		false;
+#endif
+
+	// Allocations made so far by the calling thread
+	uint64_t ThreadAllocations();
+}
@@ -3,203 +3,497 @@
 
 namespace fs = std::filesystem;
 
-void AudioStream::file_path_getter(std::string folder_path, bool is_rain, bool is_night)
+void AudioStream::file_path_getter(const fs::path& folder_path, bool is_rain, bool is_night)
 {
-	for (const auto& entry : fs::directory_iterator(folder_path))
+	// The manifest walks the folder only when it changed; the files of the
+	// scene are then a lookup
+	NoiseManifest& manifest = manifestFor(folder_path);
+
+	// No files: with an adaptive noise floor the scene still gets a reducer
+	if (!manifest.Refresh())
+	{
+		noise_paths.clear();
+		return;
+	}
+
+	noise_paths = manifest.ScenePaths(is_rain, is_night);
+}
+
+NoiseManifest& AudioStream::manifestFor(const fs::path& folder_path)
+{
+	std::unique_ptr<NoiseManifest>& manifest = noiseManifests_[folder_path.string()];
+
+	if (!manifest)
 	{
-		if (fs::is_regular_file(entry.status()))
+		const fs::path cachePath = folder_path.parent_path() / PROFILE_CACHE_FOLDER / folder_path.filename() / NOISE_MANIFEST_FILE;
+		manifest = std::make_unique<NoiseManifest>(folder_path.string(), cachePath.string());
+	}
+
+	return *manifest;
+}
+
+void AudioStream::preload_noise_tracks(std::string map_choose, bool is_rain, bool is_night, const NoiseReduction::Settings& settings)
+{
+	const fs::path folder_path = fs::path(NOISE_FOLDER) / map_choose;
+
+	if (map_choose == "factory" || map_choose == "outdoor" || map_choose == "residential")
+	{
+		if (!fs::is_directory(folder_path))
 		{
-			std::string file_path = entry.path().filename().string();
+			std::cout << "Folder does not exists" << std::endl;
+		}
 
-			if (file_path.find("rain") == std::string::npos && file_path.find("thunder") == std::string::npos && file_path.find("night") == std::string::npos)
-			{
-				noise_paths.push_back(folder_path + "\\" + file_path);
-			}
+		file_path_getter(folder_path, is_rain, is_night);
+	}
 
-			if (is_rain && (file_path.find("rain") != std::string::npos || file_path.find("thunder") != std::string::npos))
+	if (map_choose != "movement")
+	{
+		// Files profiled before, for this or any other scene, come from the
+		// library or its cache files; only new or changed files are profiled
+		const auto profileStart = std::chrono::steady_clock::now();
+
+		try
+		{
+			NoiseReduction::Settings reducerSettings = settings;
+			auto reducer = std::make_unique<NoiseReduction>(reducerSettings, SAMPLE_RATE);
+			const std::string cacheFolder = (folder_path.parent_path() / PROFILE_CACHE_FOLDER).string();
+			const NoiseProfile profile = libraryFor(settings, cacheFolder).Scene(noise_paths);
+
+			// The adaptive floor works alone when the scene has no noise files
+			if (profile.mTotalWindows > 0 || !settings.mAdaptiveNoise)
 			{
-				noise_paths.push_back(folder_path + "\\" + file_path);
+				reducer->SetNoiseProfile(profile);
 			}
-			
-			if (is_night && file_path.find("night") != std::string::npos)
+
+			// Started here, so the audio thread takes it up without allocating
+			reducer->BeginStream(CHANNEL_COUNT, BUFFER_SIZE);
+
+			// As is the delay line of a switch to it, handed over first
+			if (reducer->StreamLatency() > largestLatency_)
 			{
-				noise_paths.push_back(folder_path + "\\" + file_path);
+				largestLatency_ = reducer->StreamLatency();
+				delete pendingDelay_.exchange(new FloatVector(largestLatency_ * CHANNEL_COUNT), std::memory_order_acq_rel);
 			}
+
+			// One made for an older request and never taken up goes
+			delete pendingReducer_.exchange(reducer.release(), std::memory_order_acq_rel);
+
+			const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - profileStart;
+			std::cout << "Noise profile of " << noise_paths.size() << " files ready in " << elapsed.count() << " ms" << std::endl;
+		}
+		catch (const std::exception& e)
+		{
+			// The reducer in use, if any, stays
+			std::cerr << "Noise profile failed: " << e.what() << std::endl;
 		}
 	}
 }
 
-void AudioStream::preload_noise_tracks(std::string map_choose, bool is_rain, bool is_night)
+ProfileLibrary& AudioStream::libraryFor(const NoiseReduction::Settings& settings, const std::string& cacheFolder)
 {
-	std::string folder_path = "C:\\Users\\kemerios\\Desktop\\tarkov_sounds\\" + map_choose; 
-
-	if (map_choose == "factory")
+	for (auto& library : profileLibraries_)
 	{
-		if (!fs::exists(folder_path) || !fs::is_directory(folder_path))
+		if (library->Fits(settings, SAMPLE_RATE))
 		{
-			std::cout << "Folder does not exists" << std::endl;
+			return *library;
 		}
-
-		file_path_getter(folder_path, is_rain, is_night);
 	}
 
-	if (map_choose == "outdoor")
+	profileLibraries_.push_back(std::make_unique<ProfileLibrary>(settings, SAMPLE_RATE, cacheFolder));
+	return *profileLibraries_.back();
+}
+
+static const char* const map_names[] = { "factory", "outdoor", "residential" };
+
+void AudioStream::SetControls(int chunkSize, float silenceThresholdDB, const std::map<std::string, bool>& tarkov_maps, bool reduction_started,
+	const NoiseReduction::Settings& settings)
+{
+	int mapIndex = -1;
+
+	for (int i = 0; i < (int)std::size(map_names); i++)
 	{
-		std::cout << "outdoor selected" << std::endl;
+		auto it = tarkov_maps.find(map_names[i]);
 
-		if (!fs::exists(folder_path) || !fs::is_directory(folder_path))
+		if (it != tarkov_maps.end() && it->second)
 		{
-			std::cout << "Folder does not exists" << std::endl;
+			mapIndex = i;
+			break;
 		}
+	}
 
-		file_path_getter(folder_path, is_rain, is_night);
+	auto flag = [&tarkov_maps](const char* name)
+	{
+		auto it = tarkov_maps.find(name);
+		return it != tarkov_maps.end() && it->second;
+	};
+
+	chunkSize_.store(chunkSize, std::memory_order_relaxed);
+	silenceThresholdDB_.store(silenceThresholdDB, std::memory_order_relaxed);
+	bypass_.store(flag("Bypass"), std::memory_order_relaxed);
+	reductionStarted_.store(reduction_started, std::memory_order_release);
+
+	Scene scene;
+	scene.mapIndex = mapIndex;
+	scene.rain = flag("rain");
+	scene.night = flag("night");
+
+	if (reduction_started && mapIndex >= 0 &&
+		(!sceneRequested_ || !(scene == requestedScene_) || settings != requestedSettings_))
+	{
+		sceneRequested_ = true;
+		requestedScene_ = scene;
+		requestedSettings_ = settings;
+
+		requestProfile(scene, settings);
 	}
 
-	if (map_choose == "residential")
+	// Freed here rather than on the audio thread
+	delete retiredReducer_.exchange(nullptr, std::memory_order_acq_rel);
+	delete retiredDelay_.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+void AudioStream::audioThreadLoop()
+{
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#endif
+
+	while (running_.load(std::memory_order_acquire))
 	{
-		if (!fs::exists(folder_path) || !fs::is_directory(folder_path))
+		if (captureRing_.ReadAvailable() < BUFFER_SIZE)
 		{
-			std::cout << "Folder does not exists" << std::endl;
+			std::unique_lock<std::mutex> lock(dspWakeMutex_);
+			dspWake_.wait_for(lock, std::chrono::milliseconds(5), [this]
+			{
+				return captureRing_.ReadAvailable() >= BUFFER_SIZE || !running_.load(std::memory_order_acquire);
+			});
+			continue;
 		}
 
-		file_path_getter(folder_path, is_rain, is_night);
+		AudioProcessing();
 	}
+}
 
-	if (map_choose != "movement")
+int AudioStream::paCallback(const void* input, void* output, unsigned long frameCount,
+	const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void* userData)
+{
+	auto* self = static_cast<AudioStream*>(userData);
+
+	if (input != nullptr)
 	{
-		for (const auto& filename : noise_paths)
-		{
-			std::cout << filename << std::endl;
+		self->captureRing_.Write(static_cast<const float*>(input), frameCount);
+	}
+	else
+	{
+		self->captureRing_.WriteSilence(frameCount);
+	}
 
-			stereoBuffer = bored.load_wav(filename.c_str(), frames);
+	self->playbackRing_.Read(static_cast<float*>(output), frameCount);
 
-			noiseTrack = bored.copyBufferToVector(stereoBuffer, frames).Buffer();
+	self->dspWake_.notify_one();
 
-			free(stereoBuffer);
-		}
+	return paContinue;
+}
+
+void AudioStream::stopAudioThread()
+{
+	running_.store(false, std::memory_order_release);
 
-		auto noiseProfileTrack = InputTrack(noiseTrack);
-		reductionObj->ProfileNoise(noiseProfileTrack);
-		noiseProfiled = true;
+	if (audioThread_.joinable())
+	{
+		audioThread_.join();
 	}
+}
+
+void AudioStream::requestProfile(const Scene& scene, const NoiseReduction::Settings& settings)
+{
+	std::lock_guard<std::mutex> lock(profileMutex_);
+
+	profileScene_ = scene;
+	profileSettings_ = settings;
+	profileRequestPending_ = true;
 
+	if (!profileThread_.joinable())
+	{
+		profileThread_ = std::thread(&AudioStream::profileThreadLoop, this);
+	}
+
+	profileWake_.notify_one();
 }
 
-void AudioStream::AudioProcessing(float& angle, int chunkSize, float silenceThresholdDB, std::map<std::string, bool>& tarkov_maps, bool& reduction_started)
+void AudioStream::profileThreadLoop()
 {
-	Pa_ReadStream(stream_, in_buffer, BUFFER_SIZE);
-	
-	if (in_buffer != NULL)
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+
+	for (;;)
 	{
-		if (reduction_started)
+		Scene scene;
+		NoiseReduction::Settings settings;
 		{
-			if (preload == false)
+			std::unique_lock<std::mutex> lock(profileMutex_);
+			profileWake_.wait(lock, [this] { return profileStop_ || profileRequestPending_; });
+
+			if (profileStop_)
 			{
-				for (const auto& map : tarkov_maps)
-				{
-					if (map.second == true)
-					{
-						mapChoosen = map.second;
+				return;
+			}
 
-						preload_noise_tracks(map.first, tarkov_maps["rain"], tarkov_maps["night"]);
+			scene = profileScene_;
+			settings = profileSettings_;
+			profileRequestPending_ = false;
+		}
 
-						break;
-					}
-				}
+		preload_noise_tracks(map_names[scene.mapIndex], scene.rain, scene.night, settings);
+	}
+}
 
-				preload = true;
-			}
+void AudioStream::stopProfileThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(profileMutex_);
+		profileStop_ = true;
+	}
+	profileWake_.notify_one();
 
-			if (mapChoosen)
-			{
+	// A scene being profiled is finished first
+	if (profileThread_.joinable())
+	{
+		profileThread_.join();
+	}
+}
 
-				audioTrack = bored.copyBufferToVector(in_buffer, BUFFER_SIZE).Buffer();
+void AudioStream::crossfadeBlock()
+{
+	incomingReducer_->ProcessInterleaved(in_buffer.data(), fade_buffer.data(), BUFFER_SIZE);
+
+	// Whichever reducer is ahead waits for the other.  Until both delay
+	// lines are full the new reducer puts out silence, so the old one is
+	// heard alone.
+	delayBlock(delayIncoming_ ? fade_buffer : out_buffer);
 
+	size_t frame = std::min<size_t>(warmupFrames_, BUFFER_SIZE);
+	warmupFrames_ -= frame;
 
-				// Only process if noise profile has been built
-				if (!noiseProfiled) return;
+	for (; frame < BUFFER_SIZE && fadePosition_ < crossfadeFrames_; ++frame, ++fadePosition_)
+	{
+		const float gain = (float)(fadePosition_ + 1) / crossfadeFrames_;
 
-				// Split interleaved stereo into separate channels for correct FFT processing
-				FloatVector leftInput, rightInput;
-				leftInput.reserve(audioTrack.size() / 2);
-				rightInput.reserve(audioTrack.size() / 2);
-				for (size_t i = 0; i < audioTrack.size() / 2; i++) {
-					leftInput.push_back(audioTrack[i * 2]);
-					rightInput.push_back(audioTrack[i * 2 + 1]);
-				}
+		for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
+		{
+			float& out = out_buffer[frame * CHANNEL_COUNT + ch];
+			out += gain * (fade_buffer[frame * CHANNEL_COUNT + ch] - out);
+		}
+	}
+
+	if (fadePosition_ == crossfadeFrames_)
+	{
+		// The rest of the block is the new reducer's alone
+		std::copy(fade_buffer.begin() + frame * CHANNEL_COUNT, fade_buffer.end(), out_buffer.begin() + frame * CHANNEL_COUNT);
+
+		finishSwitch();
+	}
+}
 
-				auto leftTrack = InputTrack(leftInput);
-				OutputTrack leftOutput;
-				reductionObj->ReduceNoise(leftTrack, leftOutput);
+void AudioStream::delayBlock(FloatVector& buffer)
+{
+	if (delayFrames_ == 0)
+	{
+		return;
+	}
 
-				auto rightTrack = InputTrack(rightInput);
-				OutputTrack rightOutput;
-				reductionObj->ReduceNoise(rightTrack, rightOutput);
+	float* line = fadeDelay_->data();
 
-				FloatVector leftProcessed = leftOutput.Buffer();
-				FloatVector rightProcessed = rightOutput.Buffer();
+	for (size_t frame = 0; frame < BUFFER_SIZE; ++frame)
+	{
+		for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
+		{
+			std::swap(buffer[frame * CHANNEL_COUNT + ch], line[delayPosition_ * CHANNEL_COUNT + ch]);
+		}
 
-				// Re-interleave into audioFinalProcessed
-				audioFinalProcessed.resize(audioTrack.size());
-				size_t outLen = std::min(leftProcessed.size(), rightProcessed.size());
-				for (size_t i = 0; i < outLen; i++) {
-					audioFinalProcessed[i * 2]     = leftProcessed[i];
-					audioFinalProcessed[i * 2 + 1] = rightProcessed[i];
-				}
+		if (++delayPosition_ == delayFrames_)
+		{
+			delayPosition_ = 0;
+		}
+	}
+}
 
-				/*auto start = std::chrono::high_resolution_clock::now();
+void AudioStream::finishSwitch()
+{
+	// Empty: a switch only starts once the last retired reducer is freed
+	retiredReducer_.store(reductionObj, std::memory_order_release);
 
-				auto end = std::chrono::high_resolution_clock::now();
+	reductionObj = incomingReducer_;
+	incomingReducer_ = nullptr;
 
-				auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	algorithmicLatency_.store(reductionObj->StreamLatency(), std::memory_order_relaxed);
+}
 
-				std::cout << "Duration: " << duration << " ms" << std::endl;*/
+void AudioStream::AudioProcessing()
+{
+	// Reducers are built and started on the profile thread, so no block
+	// of the DSP stage may touch the heap
+	const uint64_t allocationsBefore = AllocationCounter::ThreadAllocations();
 
-				bored.processBuffer(audioFinalProcessed, chunkSize, silenceThresholdDB);
+	if (!Resampling())
+	{
+		captureRing_.Read(in_buffer.data(), BUFFER_SIZE);
+		processBlock();
 
-				FloatVector leftChannel;
-				FloatVector rightChannel;
+		// Keep the output fed on every block, also while profiling or bypassed
+		playbackRing_.Write(out_buffer.data(), BUFFER_SIZE);
+	}
+	else
+	{
+		// One device block makes a block at SAMPLE_RATE give or take a
+		// few frames, so now and then there are none or two to process
+		captureRing_.Read(deviceBuffer_.data(), BUFFER_SIZE);
+		convertedFrames_ += captureResampler_->Process(deviceBuffer_.data(), BUFFER_SIZE, &convertedInput_[convertedFrames_ * CHANNEL_COUNT]);
 
-				bored.splitInterleavedStereo(audioTrack, leftChannel, rightChannel);
+		size_t taken = 0;
+		for (; convertedFrames_ - taken >= BUFFER_SIZE; taken += BUFFER_SIZE)
+		{
+			std::copy_n(&convertedInput_[taken * CHANNEL_COUNT], BUFFER_SIZE * CHANNEL_COUNT, in_buffer.begin());
+			processBlock();
 
-				auto angle_calculation = bored.calculateNeedleAngle(leftChannel, rightChannel);
+			const size_t frames = playbackResampler_->Process(out_buffer.data(), BUFFER_SIZE, convertedOutput_.data());
+			playbackRing_.Write(convertedOutput_.data(), frames);
+		}
 
-				if (!angle_calculation == 0.0f)
-				{
-					angle = angle_calculation;
-				}
+		std::copy(convertedInput_.begin() + taken * CHANNEL_COUNT, convertedInput_.begin() + convertedFrames_ * CHANNEL_COUNT, convertedInput_.begin());
+		convertedFrames_ -= taken;
+	}
 
-				for (size_t i = 0; i < BUFFER_SIZE; i++) {
-					out_buffer[i * CHANNEL_COUNT] = audioFinalProcessed[i * CHANNEL_COUNT];
-					out_buffer[i * CHANNEL_COUNT + 1] = audioFinalProcessed[i * CHANNEL_COUNT + 1];
-				}
+	hotPathAllocations_.fetch_add(AllocationCounter::ThreadAllocations() - allocationsBefore, std::memory_order_relaxed);
+}
 
-				auto start = std::chrono::high_resolution_clock::now();
+void AudioStream::processBlock()
+{
+	const bool reduction_started = reductionStarted_.load(std::memory_order_acquire);
+	const bool bypass = bypass_.load(std::memory_order_relaxed);
+
+	// A reducer for a new scene or new settings starts a switch, unless one
+	// is running or the UI thread has yet to free the last reducer or
+	// delay line given up
+	if (incomingReducer_ == nullptr && retiredReducer_.load(std::memory_order_acquire) == nullptr &&
+		retiredDelay_.load(std::memory_order_acquire) == nullptr)
+	{
+		if (NoiseReduction* pending = pendingReducer_.exchange(nullptr, std::memory_order_acq_rel))
+		{
+			// A line handed over with or after the reducer; the last one
+			// taken up fits it otherwise
+			if (FloatVector* delay = pendingDelay_.exchange(nullptr, std::memory_order_acq_rel))
+			{
+				retiredDelay_.store(fadeDelay_, std::memory_order_release);
+				fadeDelay_ = delay;
+			}
 
-				Pa_WriteStream(stream_, out_buffer, BUFFER_SIZE);
+			incomingReducer_ = pending;
+			fadePosition_ = 0;
 
-				auto end = std::chrono::high_resolution_clock::now();
+			// Nothing to fade from: the first reducer comes in at once
+			if (reductionObj == nullptr)
+			{
+				finishSwitch();
+			}
+			else
+			{
+				const size_t incoming = pending->StreamLatency();
+				const size_t current = reductionObj->StreamLatency();
 
-				auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+				delayIncoming_ = incoming < current;
+				delayFrames_ = delayIncoming_ ? current - incoming : incoming - current;
+				delayPosition_ = 0;
+				std::fill_n(fadeDelay_->begin(), delayFrames_ * CHANNEL_COUNT, 0.0f);
 
-				std::cout << "Duration: " << duration << " ms" << std::endl;
+				warmupFrames_ = std::max(incoming, current);
 			}
 		}
+	}
+
+	bool processed = false;
+
+	if (reduction_started && reductionObj != nullptr && !bypass)
+	{
+		// The reducer keeps its streaming worker alive across blocks, so
+		// the history of both channels carries over between calls.  Both
+		// channels in one pass, straight from and to the interleaved blocks.
+		reductionObj->ProcessInterleaved(in_buffer.data(), out_buffer.data(), BUFFER_SIZE);
 
-		if (!reduction_started || tarkov_maps["Bypass"])
+		if (incomingReducer_ != nullptr)
 		{
-			//static HighPassFilter hpFilter(500.0f, SAMPLE_RATE);
+			crossfadeBlock();
+		}
 
-			//hpFilter.processBuffer(audio_tracks);
+		bored.processBuffer(out_buffer.data(), out_buffer.size(), chunkSize_.load(std::memory_order_relaxed), silenceThresholdDB_.load(std::memory_order_relaxed));
 
-			for (size_t i = 0; i < BUFFER_SIZE; i++) {
-				out_buffer[i * 2] = in_buffer[i * 2];
-				out_buffer[i * 2 + 1] = in_buffer[i * 2 + 1];
-			}
+		auto angle_calculation = bored.calculateNeedleAngle(in_buffer.data(), BUFFER_SIZE);
 
-			Pa_WriteStream(stream_, out_buffer, BUFFER_SIZE);
+		if (!angle_calculation == 0.0f)
+		{
+			angle_.store(angle_calculation, std::memory_order_relaxed);
 		}
+
+		leftLevel_.store(bored.calculateRMS(in_buffer.data(), BUFFER_SIZE, 2), std::memory_order_relaxed);
+		rightLevel_.store(bored.calculateRMS(in_buffer.data() + 1, BUFFER_SIZE, 2), std::memory_order_relaxed);
+
+		processed = true;
+	}
+	else if (incomingReducer_ != nullptr)
+	{
+		// Nothing is heard of either reducer, so there is nothing to fade
+		finishSwitch();
+	}
+
+	if (!processed)
+	{
+		//static HighPassFilter hpFilter(500.0f, SAMPLE_RATE);
+
+		//hpFilter.processBuffer(audio_tracks);
+
+		std::copy(in_buffer.begin(), in_buffer.end(), out_buffer.begin());
+	}
+}
+
+bool AudioStream::setupConversion(double deviceRate)
+{
+	if (deviceRate <= 0.0 || deviceRate > SAMPLE_RATE * MAX_RATE_RATIO || SAMPLE_RATE > deviceRate * MAX_RATE_RATIO)
+	{
+		std::cout << "Device samplerate " << deviceRate << " is too far from " << SAMPLE_RATE << std::endl;
+		return false;
+	}
+
+	try
+	{
+		captureResampler_ = std::make_unique<Resampler>(deviceRate, SAMPLE_RATE, CHANNEL_COUNT, resamplerQuality_);
+		playbackResampler_ = std::make_unique<Resampler>(SAMPLE_RATE, deviceRate, CHANNEL_COUNT, resamplerQuality_);
+	}
+	catch (const std::exception& e)
+	{
+		captureResampler_.reset();
+		playbackResampler_.reset();
+
+		std::cout << "Cannot convert device samplerate " << deviceRate << ": " << e.what() << std::endl;
+		return false;
 	}
+
+	deviceRate_ = deviceRate;
+
+	// Up to a block waits in convertedInput_ for the rest of it
+	deviceBuffer_.assign(BUFFER_SIZE * CHANNEL_COUNT, 0.0f);
+	convertedInput_.assign((BUFFER_SIZE - 1 + captureResampler_->MaxOutput(BUFFER_SIZE)) * CHANNEL_COUNT, 0.0f);
+	convertedFrames_ = 0;
+	convertedOutput_.assign(playbackResampler_->MaxOutput(BUFFER_SIZE) * CHANNEL_COUNT, 0.0f);
+
+	// Processed blocks come back in bursts of device frames; playback starts
+	// with one more burst of silence so it never waits for the next
+	prefillFrames_ += playbackResampler_->MaxOutput(BUFFER_SIZE);
+
+	conversionLatency_ = captureResampler_->Latency() + (size_t)(playbackResampler_->Latency() * SAMPLE_RATE / deviceRate);
+
+	std::cout << "Device samplerate " << deviceRate << ", converted to " << SAMPLE_RATE << " (" << ResamplerQualityName(resamplerQuality_) << ")" << std::endl;
+	return true;
 }
 
 bool AudioStream::initStreamObj()
@@ -225,7 +519,18 @@ bool AudioStream::openStream()
 		return false;
 	}
 
-	PaError err = Pa_OpenStream(&stream_, &inputParameters, &outputParameters, SAMPLE_RATE, BUFFER_SIZE, paClipOff, nullptr, this);
+	// Devices that will not run at SAMPLE_RATE are opened at the rate of the
+	// input device, and the DSP stage converts on the way in and out
+	if (Pa_IsFormatSupported(&inputParameters, &outputParameters, SAMPLE_RATE) != paFormatIsSupported)
+	{
+		if (!setupConversion(Pa_GetDeviceInfo(inputParameters.device)->defaultSampleRate))
+		{
+			Pa_Terminate();
+			return false;
+		}
+	}
+
+	PaError err = Pa_OpenStream(&stream_, &inputParameters, &outputParameters, deviceRate_, BUFFER_SIZE, paClipOff, &AudioStream::paCallback, this);
 
 	if (err != paNoError)
 	{
@@ -243,6 +548,8 @@ bool AudioStream::openStream()
 
 bool AudioStream::startStream()
 {
+	playbackRing_.WriteSilence(prefillFrames_);
+
 	PaError err = Pa_StartStream(stream_);
 
 	if (err != paNoError)
@@ -254,12 +561,27 @@ bool AudioStream::startStream()
 	{
 		std::cout << "" << std::endl;
 		std::cout << "Stream Started" << std::endl;
+
+		if (const PaStreamInfo* info = Pa_GetStreamInfo(stream_))
+		{
+			deviceLatency_.store((size_t)((info->inputLatency + info->outputLatency) * SAMPLE_RATE), std::memory_order_relaxed);
+		}
+
+		std::cout << "Block size: " << BUFFER_SIZE << " frames, latency before reduction: " << LatencyMs() << " ms" << std::endl;
+
+		// The DSP stage runs on its own thread between the two rings, so
+		// neither the callback nor the UI ever waits for it
+		running_.store(true, std::memory_order_release);
+		audioThread_ = std::thread(&AudioStream::audioThreadLoop, this);
+
 		return true;
 	}
 }
 
 void AudioStream::closeStream()
 {
+	stopAudioThread();
+
 	PaError err = Pa_CloseStream(stream_);
 
 	if (err != paNoError)
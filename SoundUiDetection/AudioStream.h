@@ -15,10 +15,19 @@
 #include <execution>
 #include <chrono>
 #include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <omp.h>
 #include "InputTrack.h"
 #include "OutputTrack.h"
+#include "NoiseManifest.h"
 #include "NoiseReduction.h"
+#include "ProfileLibrary.h"
+#include "Resampler.h"
+#include "RingBuffer.h"
+#include "AllocationCounter.h"
 #include "gpuWrapper.hpp"
 
 #include "to_bored.h"
@@ -26,20 +35,39 @@
 class AudioStream
 {
 public:
-	AudioStream(NoiseReduction* reductionObj, float sample_rate) 
-		: reductionObj(reductionObj), SAMPLE_RATE(sample_rate)
+	// Blocks between MIN_BLOCK_SIZE and MAX_BLOCK_SIZE frames are honoured
+	// by the device stream, the rings and the reducer alike
+	static constexpr unsigned long MIN_BLOCK_SIZE = 64;
+	static constexpr unsigned long MAX_BLOCK_SIZE = 4096;
+
+	// Devices that do not run at sample_rate are opened at their own rate;
+	// resampler_quality sets the conversion, see ResamplerQuality
+	AudioStream(float sample_rate, unsigned long block_size = 2048, ResamplerQuality resampler_quality = ResamplerQuality::Fast) 
+		: SAMPLE_RATE(sample_rate), BUFFER_SIZE(std::clamp(block_size, MIN_BLOCK_SIZE, MAX_BLOCK_SIZE)), resamplerQuality_(resampler_quality)
 	{
 
 	}
 
 	~AudioStream()
 	{
+		stopAudioThread();
+		stopProfileThread();
+
 		if (stream_)
 		{
 			Pa_StopStream(stream_);
 			Pa_CloseStream(stream_);
 			Pa_Terminate();
 		}
+
+		// Neither thread is left to use them
+		delete reductionObj;
+		delete incomingReducer_;
+		delete pendingReducer_.exchange(nullptr);
+		delete retiredReducer_.exchange(nullptr);
+		delete fadeDelay_;
+		delete pendingDelay_.exchange(nullptr);
+		delete retiredDelay_.exchange(nullptr);
 	}
 
 	bool initStreamObj();
@@ -50,7 +78,43 @@ public:
 
 	void closeStream();
 
-	void AudioProcessing(float& angle, int chunkSize, float silenceThresholdDB, std::map<std::string, bool>& tarkov_maps, bool& reduction_started);
+	// Called from the UI thread every frame. Only stores into atomics, the
+	// audio thread picks the values up at its next block.  A new scene or
+	// new settings are handed to the profile thread, which makes a reducer
+	// for them; the audio thread crossfades to it without a dropout.
+	void SetControls(int chunkSize, float silenceThresholdDB, const std::map<std::string, bool>& tarkov_maps, bool reduction_started,
+		const NoiseReduction::Settings& settings);
+
+	// State published by the audio thread for the UI
+	float NeedleAngle() const { return angle_.load(std::memory_order_relaxed); }
+	float LeftLevel() const { return leftLevel_.load(std::memory_order_relaxed); }
+	float RightLevel() const { return rightLevel_.load(std::memory_order_relaxed); }
+
+	// Blocks of input dropped because the DSP stage fell behind
+	uint64_t CaptureOverruns() const { return captureRing_.Overruns(); }
+	// Device buffers that got silence because no processed output was ready
+	uint64_t PlaybackUnderruns() const { return playbackRing_.Underruns(); }
+
+	// Rate the devices run at; SAMPLE_RATE unless they would not open at it
+	double DeviceRate() const { return deviceRate_; }
+	bool Resampling() const { return captureResampler_ != nullptr; }
+	ResamplerQuality ResamplerQualityChoice() const { return resamplerQuality_; }
+
+	// End-to-end delay from capture to playback: the queued playback frames,
+	// the reducer's lookahead once it is streaming, the delay of the rate
+	// conversion if any, and what the device reports for its own input and
+	// output buffering.  In samples at SAMPLE_RATE.
+	unsigned long BlockSize() const { return BUFFER_SIZE; }
+	size_t BufferingLatency() const { return (size_t)(prefillFrames_ * SAMPLE_RATE / deviceRate_); }
+	size_t AlgorithmicLatency() const { return algorithmicLatency_.load(std::memory_order_relaxed); }
+	size_t ConversionLatency() const { return conversionLatency_; }
+	size_t DeviceLatency() const { return deviceLatency_.load(std::memory_order_relaxed); }
+	size_t LatencySamples() const { return BufferingLatency() + AlgorithmicLatency() + ConversionLatency() + DeviceLatency(); }
+	float LatencyMs() const { return LatencySamples() * 1000.0f / SAMPLE_RATE; }
+
+	// Heap allocations seen on the DSP stage outside of setup blocks;
+	// counted in debug builds only, see AllocationCounter
+	uint64_t HotPathAllocations() const { return hotPathAllocations_.load(std::memory_order_relaxed); }
 
 	void findInputDeviceIndex();
 
@@ -59,33 +123,175 @@ private:
 	unsigned long BUFFER_SIZE = 2048;
 	int CHANNEL_COUNT = 2;
 
-	float* in_buffer = (float*)malloc(BUFFER_SIZE * 2 * sizeof(float));
-	float* out_buffer = (float*)malloc(BUFFER_SIZE * 2 * sizeof(float));
+	// Ring depth in blocks, and how many blocks of silence playback starts
+	// with so the DSP stage has a block of slack before it is late.  Small
+	// blocks get at least MIN_PREFILL_FRAMES of slack for scheduler jitter.
+	static constexpr size_t RING_BLOCKS = 4;
+	static constexpr size_t PREFILL_BLOCKS = 2;
+	static constexpr size_t MIN_PREFILL_FRAMES = 256;
+
+	size_t prefillFrames_ = std::max<size_t>(BUFFER_SIZE * PREFILL_BLOCKS, MIN_PREFILL_FRAMES);
+
+	// Device rates up to MAX_RATE_RATIO times SAMPLE_RATE are converted.
+	// One block at SAMPLE_RATE comes back as up to that many device blocks
+	// at once, so the playback ring has room for them on top of a prefill
+	// that grows by as much.
+	static constexpr size_t MAX_RATE_RATIO = 4;
+
+	// PortAudio callback -> DSP thread -> PortAudio callback, in device frames
+	FrameRingBuffer captureRing_{ std::max<size_t>(BUFFER_SIZE * RING_BLOCKS, prefillFrames_ + 2 * BUFFER_SIZE), 2 };
+	FrameRingBuffer playbackRing_{ std::max<size_t>(BUFFER_SIZE * RING_BLOCKS, prefillFrames_ + 2 * BUFFER_SIZE) + 2 * MAX_RATE_RATIO * BUFFER_SIZE, 2 };
+
+	// The callback wakes the DSP stage when it has queued input, so small
+	// blocks do not depend on the sleep granularity of the OS
+	std::mutex dspWakeMutex_;
+	std::condition_variable dspWake_;
+
+	std::atomic<size_t> algorithmicLatency_{ 0 };
+	std::atomic<size_t> deviceLatency_{ 0 };
+
+	// Working buffers of the DSP stage, sized once for the block size so
+	// the steady state never allocates; fade_buffer takes the output of the
+	// incoming reducer during a switch
+	FloatVector in_buffer = FloatVector(BUFFER_SIZE * 2);
+	FloatVector out_buffer = FloatVector(BUFFER_SIZE * 2);
+	FloatVector fade_buffer = FloatVector(BUFFER_SIZE * 2);
+
+	std::atomic<uint64_t> hotPathAllocations_{ 0 };
+
+	// Rate conversion between the devices and the DSP stage, set up by
+	// openStream when the devices run at another rate.  The captured block
+	// is converted into convertedInput_, which is processed a whole block
+	// at a time; what is left waits for the next device block.
+	const ResamplerQuality resamplerQuality_;
+	double deviceRate_ = SAMPLE_RATE;
+	size_t conversionLatency_ = 0;
+	std::unique_ptr<Resampler> captureResampler_;
+	std::unique_ptr<Resampler> playbackResampler_;
+	FloatVector deviceBuffer_;
+	FloatVector convertedInput_;
+	size_t convertedFrames_ = 0;
+	FloatVector convertedOutput_;
 
 	PaStreamParameters inputParameters;
 	PaStreamParameters outputParameters;
 
-	float* stereoBuffer;
-	sf_count_t frames;
-	const char* filename;
+	// One folder of noise files per map
+	static constexpr const char* NOISE_FOLDER = "C:\\Users\\kemerios\\Desktop\\tarkov_sounds";
+
+	// Next to the map folders, one cache file per noise file and the
+	// manifest of each map folder
+	static constexpr const char* PROFILE_CACHE_FOLDER = "profile_cache";
+	static constexpr const char* NOISE_MANIFEST_FILE = "noise.manifest";
+
+	// Manifest of every map folder seen so far, by folder; used by the
+	// profile thread only
+	std::map<std::string, std::unique_ptr<NoiseManifest>> noiseManifests_;
+
+	// Profiles of every noise file seen so far, one library per window
+	// size; used by the profile thread only
+	std::vector<std::unique_ptr<ProfileLibrary>> profileLibraries_;
 
 	std::vector<std::string> noise_paths;
-	FloatVector noiseTrack;
 
+	// A switch of reducers: the new one runs alongside the old one until
+	// the delay lines of both are full, then the output fades over to it
+	// in crossfadeFrames_, at least MIN_CROSSFADE_FRAMES
+	static constexpr size_t CROSSFADE_BLOCKS = 4;
+	static constexpr size_t MIN_CROSSFADE_FRAMES = 2048;
+
+	const size_t crossfadeFrames_ = std::max<size_t>(BUFFER_SIZE * CROSSFADE_BLOCKS, MIN_CROSSFADE_FRAMES);
+	size_t warmupFrames_ = 0;
+	size_t fadePosition_ = 0;
+
+	// The reducer in use and the one fading in, owned by the audio thread
+	NoiseReduction* reductionObj = nullptr;
+	NoiseReduction* incomingReducer_ = nullptr;
+
+	// Profile thread -> audio thread: a reducer ready to stream.  Audio
+	// thread -> UI thread: the reducer it gave up, freed in SetControls.
+	std::atomic<NoiseReduction*> pendingReducer_{ nullptr };
+	std::atomic<NoiseReduction*> retiredReducer_{ nullptr };
 
-	bool preload = false;
-	bool noiseProfiled = false;
+	// During a switch the reducer of lower StreamLatency() goes through a
+	// delay line of the difference, so the two fade in step.  The profile
+	// thread makes a longer line whenever it makes a reducer of more delay
+	// than any before, so the line taken up with a reducer fits a switch
+	// from any of the earlier ones; lines given up go as reducers do.
+	// largestLatency_ is the profile thread's, fadeDelay_ and after it
+	// the audio thread's.
+	size_t largestLatency_ = 0;
+	std::atomic<FloatVector*> pendingDelay_{ nullptr };
+	std::atomic<FloatVector*> retiredDelay_{ nullptr };
+	FloatVector* fadeDelay_ = nullptr;
+	size_t delayFrames_ = 0;
+	size_t delayPosition_ = 0;
+	bool delayIncoming_ = false;
 
+	struct Scene
+	{
+		int mapIndex = -1;
+		bool rain = false;
+		bool night = false;
+
+		bool operator==(const Scene& other) const { return mapIndex == other.mapIndex && rain == other.rain && night == other.night; }
+	};
+
+	// What the profile thread was last asked for; UI thread only
+	bool sceneRequested_ = false;
+	Scene requestedScene_;
+	NoiseReduction::Settings requestedSettings_;
+
+	// UI thread -> profile thread; a newer request replaces one not yet started
+	std::mutex profileMutex_;
+	std::condition_variable profileWake_;
+	bool profileRequestPending_ = false;
+	bool profileStop_ = false;
+	Scene profileScene_;
+	NoiseReduction::Settings profileSettings_;
 
-	FloatVector audioTrack;
-	FloatVector audioFinalProcessed;
+	// Capture stage and playback stage, run by PortAudio
+	static int paCallback(const void* input, void* output, unsigned long frameCount,
+		const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void* userData);
 
-	bool mapChoosen = false;
+	// DSP stage: one block from the capture ring, reduced, into the playback
+	// ring; processBlock turns in_buffer into out_buffer at SAMPLE_RATE
+	void AudioProcessing();
+	void processBlock();
+	bool setupConversion(double deviceRate);
+	void audioThreadLoop();
+	void stopAudioThread();
+	// Mixes the incoming reducer into out_buffer, and hands over at the end
+	void crossfadeBlock();
+	void delayBlock(FloatVector& buffer);
+	void finishSwitch();
 
-	void preload_noise_tracks(std::string map_choose, bool is_rain, bool is_night);
-	void file_path_getter(std::string map_choose, bool is_rain, bool is_night);
+	// Profile thread: finds the noise files of the scene, merges their
+	// profiles from the library into a new reducer and hands it to the
+	// audio thread, ready to stream
+	void requestProfile(const Scene& scene, const NoiseReduction::Settings& settings);
+	void profileThreadLoop();
+	void stopProfileThread();
+	void preload_noise_tracks(std::string map_choose, bool is_rain, bool is_night, const NoiseReduction::Settings& settings);
+	void file_path_getter(const std::filesystem::path& folder_path, bool is_rain, bool is_night);
+	NoiseManifest& manifestFor(const std::filesystem::path& folder_path);
+	ProfileLibrary& libraryFor(const NoiseReduction::Settings& settings, const std::string& cacheFolder);
 
-	NoiseReduction* reductionObj;
-	PaStream* stream_;
+	PaStream* stream_ = nullptr;
 	BoringFunc bored;
+
+	std::thread audioThread_;
+	std::thread profileThread_;
+	std::atomic<bool> running_{ false };
+
+	// UI -> audio thread
+	std::atomic<int> chunkSize_{ 512 };
+	std::atomic<float> silenceThresholdDB_{ -46.0f };
+	std::atomic<bool> bypass_{ false };
+	std::atomic<bool> reductionStarted_{ false };
+
+	// Audio thread -> UI
+	std::atomic<float> angle_{ 0.0f };
+	std::atomic<float> leftLevel_{ 0.0f };
+	std::atomic<float> rightLevel_{ 0.0f };
 };
\ No newline at end of file
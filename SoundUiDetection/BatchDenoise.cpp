@@ -0,0 +1,462 @@
+/*
+*  Headless batch denoiser
+*
+*  Profiles the noise in every WAV of a folder, then streams an input file
+*  through the same reducer the live app uses and writes the result, with no
+*  audio device and no window.  Meant for reproducing reductions offline and
+*  for measuring throughput on long recordings.
+*
+*  Usage:
+*    BatchDenoise <noise-folder> <input> <output.wav> [options]
+*    BatchDenoise --bench-resampler [--kernel NAME]
+*    BatchDenoise --bench-math
+*
+*  The output is 32-bit float WAV with the input's rate and channels, time
+*  aligned with the input (the stream latency is cut off the front and the
+*  tail is flushed), so files can be compared sample by sample.  Noise files
+*  at another rate than the input are converted to it before profiling.
+*
+*  Needs only libsndfile besides the reducer sources, e.g. on Linux:
+*    g++ -std=c++17 -O2 -fopenmp -pthread BatchDenoise.cpp NoiseReduction.cpp ChannelTeam.cpp RealFFTf.cpp
+*        RealFFTfSimd.cpp InputTrack.cpp OutputTrack.cpp ProfileBuilder.cpp ProfileCache.cpp ProfileLibrary.cpp Resampler.cpp WavReader.cpp -lsndfile -o BatchDenoise
+*/
+
+#define _USE_MATH_DEFINES
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sndfile.h>
+#include "DspMath.h"
+#include "NoiseReduction.h"
+#include "ProfileLibrary.h"
+#include "RealFFTf.h"
+#include "Resampler.h"
+#include "WavReader.h"
+
+namespace fs = std::filesystem;
+
+struct BatchOptions
+{
+	std::string noiseFolder;
+	std::string inputPath;
+	std::string outputPath;
+	std::string cacheFolder;
+	size_t blockSize = 2048;
+	bool benchResampler = false;
+	bool benchMath = false;
+	NoiseReduction::Settings settings;
+};
+
+static void printUsage(const char* program)
+{
+	std::cerr
+		<< "Usage: " << program << " <noise-folder> <input> <output.wav> [options]\n"
+		<< "       " << program << " --bench-resampler [--kernel NAME]\n"
+		<< "       " << program << " --bench-math\n"
+		<< "  The noise folder may be - for no profile, with --adaptive\n"
+		<< "  --block N          frames per processing block (default 2048)\n"
+		<< "  --sensitivity X    noise sensitivity (default 6)\n"
+		<< "  --gain DB          noise reduction in dB (default 25)\n"
+		<< "  --smoothing N      frequency smoothing bands (default 0)\n"
+		<< "  --window N         FFT window size, a power of two from 8 to 16384 (default 2048)\n"
+		<< "  --link             same gain in every channel\n"
+		<< "  --parallel         one core per channel\n"
+		<< "  --adaptive W       track the noise floor from the input, mixed with the profile at weight W from 0 to 1\n"
+		<< "  --cache DIR        keep the profile of every noise file in DIR, reused while the file and settings are unchanged\n"
+		<< "  --kernel NAME      FFT kernel: scalar, sse2, avx2 or avx512 (default: widest supported)\n"
+		<< "  --bench-resampler  measure the sample rate converter at every quality, then exit\n"
+		<< "  --bench-math       measure the fast logs, exponentials and decibels against the C library, then exit\n";
+}
+
+static bool parseKernel(const std::string& name, FFTKernel& kernel)
+{
+	static const struct { const char* name; FFTKernel kernel; } kernels[] = {
+		{ "scalar", FFTKernel::Scalar },
+		{ "sse2", FFTKernel::SSE2 },
+		{ "avx2", FFTKernel::AVX2 },
+		{ "avx512", FFTKernel::AVX512 },
+	};
+
+	for (const auto& candidate : kernels)
+	{
+		if (name == candidate.name)
+		{
+			kernel = candidate.kernel;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool parseArguments(int argc, char** argv, BatchOptions& options)
+{
+	std::vector<std::string> positional;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (arg == "--link")
+			options.settings.mLinkChannels = true;
+		else if (arg == "--bench-resampler")
+			options.benchResampler = true;
+		else if (arg == "--bench-math")
+			options.benchMath = true;
+		else if (arg == "--parallel")
+			options.settings.mParallelChannels = true;
+		else if (arg == "--adaptive" && hasValue)
+		{
+			options.settings.mAdaptiveNoise = true;
+			options.settings.mAdaptiveWeight = std::atof(argv[++i]);
+		}
+		else if (arg == "--cache" && hasValue)
+			options.cacheFolder = argv[++i];
+		else if (arg == "--block" && hasValue)
+			options.blockSize = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--sensitivity" && hasValue)
+			options.settings.mNewSensitivity = std::atof(argv[++i]);
+		else if (arg == "--gain" && hasValue)
+			options.settings.mNoiseGain = std::atof(argv[++i]);
+		else if (arg == "--smoothing" && hasValue)
+			options.settings.mFreqSmoothingBands = std::atof(argv[++i]);
+		else if (arg == "--window" && hasValue)
+		{
+			const unsigned long windowSize = std::strtoul(argv[++i], nullptr, 10);
+			int choice = 0;
+			while ((8ul << choice) < windowSize)
+				++choice;
+			if ((8ul << choice) != windowSize || choice > 11)
+			{
+				std::cerr << "Window size must be a power of two from 8 to 16384" << std::endl;
+				return false;
+			}
+			options.settings.mWindowSizeChoice = choice;
+		}
+		else if (arg == "--kernel" && hasValue)
+		{
+			FFTKernel kernel;
+			if (!parseKernel(argv[++i], kernel))
+			{
+				std::cerr << "Unknown FFT kernel: " << argv[i] << std::endl;
+				return false;
+			}
+			SetFFTKernel(kernel);
+			if (GetFFTKernel() != kernel)
+				std::cerr << "FFT kernel " << argv[i] << " is not supported here, using " << FFTKernelName(GetFFTKernel()) << std::endl;
+		}
+		else if (arg.compare(0, 2, "--") == 0)
+		{
+			std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+			return false;
+		}
+		else
+			positional.push_back(arg);
+	}
+
+	if (options.benchResampler || options.benchMath)
+		return positional.empty();
+
+	if (positional.size() != 3 || options.blockSize == 0)
+		return false;
+
+	if (positional[0] == "-" && !options.settings.mAdaptiveNoise)
+	{
+		std::cerr << "Without noise files the noise floor must be tracked, see --adaptive" << std::endl;
+		return false;
+	}
+
+	options.noiseFolder = positional[0];
+	options.inputPath = positional[1];
+	options.outputPath = positional[2];
+	return true;
+}
+
+/// <summary>
+/// Every WAV of the folder, in name order so runs are repeatable
+/// </summary>
+static bool listNoiseFiles(const std::string& folder, std::vector<std::string>& noisePaths)
+{
+	if (!fs::exists(folder) || !fs::is_directory(folder))
+	{
+		std::cerr << "Noise folder does not exist: " << folder << std::endl;
+		return false;
+	}
+
+	for (const auto& entry : fs::directory_iterator(folder))
+	{
+		std::string extension = entry.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(),
+			[](unsigned char c) { return (char)std::tolower(c); });
+		if (entry.is_regular_file() && extension == ".wav")
+			noisePaths.push_back(entry.path().string());
+	}
+	std::sort(noisePaths.begin(), noisePaths.end());
+
+	if (noisePaths.empty())
+	{
+		std::cerr << "No noise files found in " << folder << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// <summary>
+/// Throughput of the sample rate converter for every quality between the
+/// device rates met in practice, on the widest kernel --kernel allows
+/// </summary>
+static int benchResampler()
+{
+	static const struct { double in; double out; } ratePairs[] = {
+		{ 44100, 48000 },
+		{ 48000, 44100 },
+		{ 96000, 48000 },
+		{ 48000, 96000 },
+		{ 16000, 48000 },
+	};
+	const size_t channels = 2;
+	const size_t blockSize = 2048;
+	const double seconds = 10.0;
+
+	std::cout << "Resampler, " << channels << " channels, blocks of " << blockSize << " frames, "
+		<< ResamplerKernelName() << " kernel" << std::endl;
+
+	for (const ResamplerQuality quality : { ResamplerQuality::Fast, ResamplerQuality::Balanced, ResamplerQuality::Best })
+	{
+		for (const auto& rates : ratePairs)
+		{
+			Resampler resampler(rates.in, rates.out, channels, quality);
+
+			// A tone, so the filters work on normal numbers
+			const size_t totalFrames = (size_t)(rates.in * seconds);
+			FloatVector inBuffer(blockSize * channels);
+			FloatVector outBuffer(resampler.MaxOutput(blockSize) * channels);
+			for (size_t ii = 0; ii < blockSize; ++ii)
+				for (size_t cc = 0; cc < channels; ++cc)
+					inBuffer[ii * channels + cc] = 0.5f * (float)sin(2.0 * M_PI * 1000.0 * ii / rates.in + cc);
+
+			size_t framesOut = 0;
+			const auto start = std::chrono::steady_clock::now();
+			for (size_t done = 0; done < totalFrames; done += blockSize)
+				framesOut += resampler.Process(inBuffer.data(), blockSize, outBuffer.data());
+			const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+			std::cout << "  " << ResamplerQualityName(quality) << " " << rates.in << " -> " << rates.out
+				<< ": " << resampler.Taps() << " taps, latency " << resampler.Latency() << " frames, "
+				<< framesOut / elapsed.count() / 1e6 << " Mframes/s out, "
+				<< seconds / elapsed.count() << "x real time" << std::endl;
+		}
+	}
+	return 0;
+}
+
+/// <summary>
+/// Speed and error of the DspMath functions against the C library, over
+/// the ranges the reducer, the gate and the meters feed them
+/// </summary>
+static int benchMath()
+{
+	using ArrayFunction = void (*)(const float*, float*, size_t);
+	static const struct {
+		const char* name;
+		float low, high;
+		ArrayFunction fast;
+		float (*library)(float);
+		double (*exact)(double);
+	} functions[] = {
+		{ "log2", 1e-6f, 0.5f, DspMath::Log2,
+			[](float x) { return std::log2(x); }, [](double x) { return std::log2(x); } },
+		{ "log10", 1e-6f, 0.5f, DspMath::Log10,
+			[](float x) { return std::log10(x); }, [](double x) { return std::log10(x); } },
+		{ "exp2", -20.0f, 0.0f, DspMath::Exp2,
+			[](float x) { return std::exp2(x); }, [](double x) { return std::exp2(x); } },
+		{ "pow10", -6.0f, 0.0f, DspMath::Pow10,
+			[](float x) { return std::pow(10.0f, x); }, [](double x) { return std::pow(10.0, x); } },
+		{ "linear to dB", 1e-6f, 0.5f, DspMath::LinearToDb,
+			[](float x) { return 20.0f * std::log10(x); }, [](double x) { return 20.0 * std::log10(x); } },
+		{ "dB to linear", -120.0f, 0.0f, DspMath::DbToLinear,
+			[](float x) { return std::pow(10.0f, x / 20.0f); }, [](double x) { return std::pow(10.0, x / 20.0); } },
+	};
+	const size_t count = 4096;
+	const int passes = 4000;
+
+	std::cout << "DspMath, " << (DSPMATH_SSE2 ? "SSE2" : "scalar") << ", arrays of " << count << " values" << std::endl;
+
+	FloatVector input(count), output(count);
+	volatile float sink = 0.0f;
+	for (const auto& function : functions)
+	{
+		for (size_t ii = 0; ii < count; ++ii)
+			input[ii] = function.low + (function.high - function.low) * (float)ii / (float)(count - 1);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; ++pass)
+		{
+			for (size_t ii = 0; ii < count; ++ii)
+				output[ii] = function.library(input[ii]);
+			sink = sink + output[pass % count];
+		}
+		const std::chrono::duration<double> library = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; ++pass)
+		{
+			function.fast(input.data(), output.data(), count);
+			sink = sink + output[pass % count];
+		}
+		const std::chrono::duration<double> fast = std::chrono::steady_clock::now() - start;
+
+		// In units of the last place of the exact result rounded to float
+		double worstUlp = 0.0;
+		for (size_t ii = 0; ii < count; ++ii)
+		{
+			const double exact = function.exact(input[ii]);
+			const float rounded = (float)std::fabs(exact);
+			const double ulp = std::nextafter(rounded, INFINITY) - rounded;
+			worstUlp = std::max(worstUlp, std::fabs(output[ii] - exact) / ulp);
+		}
+
+		const double values = (double)count * passes;
+		std::cout << "  " << function.name << ": library " << library.count() / values * 1e9 << " ns, DspMath "
+			<< fast.count() / values * 1e9 << " ns a value, " << library.count() / fast.count() << "x, worst "
+			<< worstUlp << " ulp" << std::endl;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	BatchOptions options;
+	if (!parseArguments(argc, argv, options))
+	{
+		printUsage(argv[0]);
+		return 2;
+	}
+
+	if (options.benchResampler)
+		return benchResampler();
+	if (options.benchMath)
+		return benchMath();
+
+	// Read a block at a time straight into the reducer's input buffer
+	WavReader input;
+	if (!input.Open(options.inputPath))
+	{
+		std::cerr << "Failed to open file: " << options.inputPath << " (" << input.Error() << ")" << std::endl;
+		return 1;
+	}
+
+	const size_t channels = input.Channels();
+	const double sampleRate = input.Rate();
+	const sf_count_t totalFrames = input.Frames();
+
+	SF_INFO outputInfo;
+	memset(&outputInfo, 0, sizeof(outputInfo));
+	outputInfo.samplerate = input.Rate();
+	outputInfo.channels = (int)input.Channels();
+	outputInfo.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+	SNDFILE* output = sf_open(options.outputPath.c_str(), SFM_WRITE, &outputInfo);
+	if (output == nullptr)
+	{
+		std::cerr << "Failed to create file: " << options.outputPath << " (" << sf_strerror(nullptr) << ")" << std::endl;
+		return 1;
+	}
+
+	int result = 0;
+	try
+	{
+		NoiseReduction reductionObj(options.settings, sampleRate);
+
+		const auto profileStart = std::chrono::steady_clock::now();
+		std::vector<std::string> noisePaths;
+		if (options.noiseFolder != "-")
+		{
+			if (!listNoiseFiles(options.noiseFolder, noisePaths))
+				throw std::runtime_error("Cannot build the noise profile");
+
+			ProfileLibrary library(options.settings, sampleRate, options.cacheFolder);
+			reductionObj.SetNoiseProfile(library.Scene(noisePaths));
+		}
+		const std::chrono::duration<double> profileTime = std::chrono::steady_clock::now() - profileStart;
+
+		const size_t blockSize = options.blockSize;
+		reductionObj.BeginStream(channels, blockSize);
+		const size_t latency = reductionObj.StreamLatency();
+
+		std::cout << "Input: " << options.inputPath << ", " << totalFrames << " frames, "
+			<< channels << " channels, " << input.Rate() << " Hz" << std::endl;
+		std::cout << "Block " << blockSize << " frames, latency " << latency << " frames, FFT "
+			<< FFTKernelName(GetFFTKernel()) << std::endl;
+
+		FloatVector inBuffer(blockSize * channels);
+		FloatVector outBuffer(blockSize * channels);
+
+		sf_count_t framesRead = 0;
+		sf_count_t framesWritten = 0;
+		size_t framesToSkip = latency;
+		std::chrono::duration<double> reduceTime(0);
+		const auto runStart = std::chrono::steady_clock::now();
+
+		// Past the end of the input, blocks of silence push the delayed tail out
+		while (framesWritten < totalFrames)
+		{
+			size_t got = 0;
+			if (framesRead < totalFrames)
+			{
+				got = input.ReadInterleaved(inBuffer.data(), blockSize);
+				framesRead += got;
+				if (got == 0)
+				{
+					std::cerr << "Did not read expected amount of frames." << std::endl;
+					framesRead = totalFrames;
+				}
+			}
+			std::fill(inBuffer.begin() + got * channels, inBuffer.end(), 0.0f);
+
+			const auto blockStart = std::chrono::steady_clock::now();
+			reductionObj.ProcessInterleaved(inBuffer.data(), outBuffer.data(), blockSize);
+			reduceTime += std::chrono::steady_clock::now() - blockStart;
+
+			const size_t skipped = std::min(framesToSkip, blockSize);
+			framesToSkip -= skipped;
+
+			const size_t toWrite = (size_t)std::min<sf_count_t>(blockSize - skipped, totalFrames - framesWritten);
+			if (sf_writef_float(output, outBuffer.data() + skipped * channels, toWrite) != (sf_count_t)toWrite)
+				throw std::runtime_error(std::string("Failed to write output: ") + sf_strerror(output));
+			framesWritten += toWrite;
+		}
+
+		const std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - runStart;
+		reductionObj.EndStream();
+
+		const double audioSeconds = totalFrames / sampleRate;
+		std::cout << "Wrote " << framesWritten << " frames to " << options.outputPath << std::endl;
+		std::cout << "Profile: " << reductionObj.GetNoiseProfile().mTotalWindows << " windows "
+			<< "from " << noisePaths.size() << " files in " << profileTime.count() << " s" << std::endl;
+		std::cout << "Audio: " << audioSeconds << " s, reduction " << reduceTime.count() << " s, with file I/O "
+			<< runTime.count() << " s" << std::endl;
+		if (audioSeconds > 0 && reduceTime.count() > 0)
+		{
+			// Real-time factor: processing time per second of audio, below 1 is faster than real time
+			std::cout << "Real-time factor: " << reduceTime.count() / audioSeconds
+				<< " (" << audioSeconds / reduceTime.count() << "x real time), with file I/O "
+				<< runTime.count() / audioSeconds << std::endl;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Error: " << e.what() << std::endl;
+		result = 1;
+	}
+
+	sf_close(output);
+	return result;
+}
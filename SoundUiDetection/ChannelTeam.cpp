@@ -0,0 +1,81 @@
+#include "ChannelTeam.h"
+
+#include <chrono>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#endif
+
+namespace
+{
+    // Long enough to catch the next round of the same hop without going to
+    // sleep, short against the time between hops
+    const auto SPIN_TIME = std::chrono::microseconds(100);
+}
+
+ChannelTeam::ChannelTeam(size_t channels)
+{
+    for (size_t cc = 1; cc < channels; ++cc)
+        mHelpers.emplace_back(&ChannelTeam::HelperLoop, this, cc);
+}
+
+ChannelTeam::~ChannelTeam()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop.store(true, std::memory_order_relaxed);
+        mRound.fetch_add(1, std::memory_order_release);
+    }
+    mWake.notify_all();
+
+    for (auto& helper : mHelpers)
+        helper.join();
+}
+
+void ChannelTeam::RunRound(Trampoline trampoline, void* job)
+{
+    mTrampoline = trampoline;
+    mJob = job;
+    mDone.store(0, std::memory_order_relaxed);
+
+    // Uncontended unless a helper is on its way to sleep
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRound.fetch_add(1, std::memory_order_release);
+    }
+    mWake.notify_all();
+
+    trampoline(job, 0);
+
+    while (mDone.load(std::memory_order_acquire) != mHelpers.size())
+        std::this_thread::yield();
+}
+
+void ChannelTeam::HelperLoop(size_t cc)
+{
+#ifdef _WIN32
+    // Holds up the thread that runs the rounds, the audio thread in the app
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#endif
+
+    unsigned seen = 0;
+    for (;;) {
+        const auto spinStart = std::chrono::steady_clock::now();
+        while (mRound.load(std::memory_order_acquire) == seen &&
+            std::chrono::steady_clock::now() - spinStart < SPIN_TIME)
+            std::this_thread::yield();
+
+        if (mRound.load(std::memory_order_acquire) == seen) {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [this, seen] { return mRound.load(std::memory_order_acquire) != seen; });
+        }
+
+        seen = mRound.load(std::memory_order_acquire);
+        if (mStop.load(std::memory_order_relaxed))
+            return;
+
+        mTrampoline(mJob, cc);
+        mDone.fetch_add(1, std::memory_order_release);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One thread per channel, started once and kept for the life of the team,
+// for work that comes in short rounds at a steady pace, such as the hops
+// of a stream.  Run hands job(cc) for every channel to the team: channel 0
+// runs on the calling thread and the rest on threads of their own, which
+// spin a little for the next round before they go to sleep.  A round
+// neither allocates nor starts a thread, so it may run on the audio thread.
+class ChannelTeam
+{
+public:
+    explicit ChannelTeam(size_t channels);
+    ~ChannelTeam();
+
+    ChannelTeam(const ChannelTeam&) = delete;
+    ChannelTeam& operator=(const ChannelTeam&) = delete;
+
+    size_t Channels() const { return mHelpers.size() + 1; }
+
+    // Returns once job(cc) has returned for every cc; job must not throw
+    template<typename Job>
+    void Run(Job& job) { RunRound(&Invoke<Job>, &job); }
+
+private:
+    typedef void (*Trampoline)(void* job, size_t cc);
+
+    template<typename Job>
+    static void Invoke(void* job, size_t cc) { (*static_cast<Job*>(job))(cc); }
+
+    void RunRound(Trampoline trampoline, void* job);
+    void HelperLoop(size_t cc);
+
+    // Set before the round is announced, read after
+    Trampoline mTrampoline = nullptr;
+    void* mJob = nullptr;
+
+    std::atomic<unsigned> mRound{ 0 };
+    std::atomic<size_t> mDone{ 0 };
+    std::atomic<bool> mStop{ false };
+
+    // For helpers that went to sleep between rounds
+    std::mutex mMutex;
+    std::condition_variable mWake;
+
+    std::vector<std::thread> mHelpers;
+};
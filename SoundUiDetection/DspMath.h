@@ -0,0 +1,340 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DSPMATH_SSE2 1
+#include <emmintrin.h>
+#else
+#define DSPMATH_SSE2 0
+#endif
+
+// Logs, exponentials and decibels in float for the per-bin and per-sample
+// loops, as the Cephes range reductions and polynomials: the logs split
+// off the exponent and take a degree 8 polynomial of the mantissa around
+// 1, the exponentials take out a power of two and a degree 6 polynomial of
+// the rest.  Checked against a double reference over every float of the
+// domain, the error is at most
+//
+//   Log2         1.5 ulp, or 1e-10 absolute where |log2| < 1e-3
+//   Log10        2 ulp, or 6e-11 absolute where |log10| < 1e-3
+//   Exp2         1.25 ulp on [-126, 127]
+//   Pow10        1.35 ulp on [-37.9, 38.2]
+//   LinearToDb   2.2 ulp, or 1e-9 dB absolute where |dB| < 1e-2
+//   DbToLinear   1.4 ulp on [-758, 764] dB
+//
+// Domain: the logs of 0 or a denormal give the log of the smallest normal
+// float, about -126 in base 2, and so LinearToDb(0) is about -759 dB;
+// negative numbers, infinities and NaN are not supported.  The
+// exponentials saturate at the ends of their ranges above, never giving
+// infinity or a denormal.
+//
+// Each function is written once for any lane type.  The array forms take
+// four at a time with SSE2, part of every x64 and of the x86 targets, and
+// the tail, or everything without SSE2, with the scalar forms, which
+// compute the same operations in the same order, so a value comes out the
+// same wherever it falls.  Arrays may be the same.
+namespace DspMath
+{
+	namespace Detail
+	{
+		constexpr float SQRT_HALF = 0.707106781186547524f;
+
+		// log2(e) - 1, and log10(e) and log10(2) in two parts each, the first
+		// exact in few bits
+		constexpr float LOG2EA = 0.44269504088896340736f;
+		constexpr float L10EA = 4.3359375e-1f;
+		constexpr float L10EB = 7.00731903251827651129e-4f;
+		constexpr float L102A = 3.0078125e-1f;
+		constexpr float L102B = 2.48745663981195213739e-4f;
+		constexpr float LOG210 = 3.32192809488736234787f;
+
+		constexpr float LOG_P0 = 7.0376836292e-2f;
+		constexpr float LOG_P1 = -1.1514610310e-1f;
+		constexpr float LOG_P2 = 1.1676998740e-1f;
+		constexpr float LOG_P3 = -1.2420140846e-1f;
+		constexpr float LOG_P4 = 1.4249322787e-1f;
+		constexpr float LOG_P5 = -1.6668057665e-1f;
+		constexpr float LOG_P6 = 2.0000714765e-1f;
+		constexpr float LOG_P7 = -2.4999993993e-1f;
+		constexpr float LOG_P8 = 3.3333331174e-1f;
+
+		constexpr float EXP2_MIN = -126.0f;
+		constexpr float EXP2_MAX = 127.0f;
+		constexpr float EXP2_P0 = 1.535336188319500e-4f;
+		constexpr float EXP2_P1 = 1.339887440266574e-3f;
+		constexpr float EXP2_P2 = 9.618437357674640e-3f;
+		constexpr float EXP2_P3 = 5.550332471162809e-2f;
+		constexpr float EXP2_P4 = 2.402264791363012e-1f;
+		constexpr float EXP2_P5 = 6.931472028550421e-1f;
+
+		// 20 log10(2) in two parts, for decibels
+		constexpr float DB2A = 6.0205078125f;
+		constexpr float DB2B = 9.2100779624e-5f;
+
+		constexpr float POW10_MIN = -37.9f;
+		constexpr float POW10_MAX = 38.2f;
+		constexpr float POW10_P0 = 2.063216740311022e-1f;
+		constexpr float POW10_P1 = 5.420251702225484e-1f;
+		constexpr float POW10_P2 = 1.171292686296281e0f;
+		constexpr float POW10_P3 = 2.034649854009453e0f;
+		constexpr float POW10_P4 = 2.650948748208892e0f;
+		constexpr float POW10_P5 = 2.302585167056758e0f;
+
+		inline uint32_t Bits(float x) { uint32_t u; std::memcpy(&u, &x, sizeof(u)); return u; }
+		inline float FromBits(uint32_t u) { float x; std::memcpy(&x, &u, sizeof(x)); return x; }
+
+		// The lane operations the functions are written in, for float here
+		// and for four floats below
+
+		inline bool Less(float a, float b) { return a < b; }
+		inline float Select(bool mask, float a, float b) { return mask ? a : b; }
+		inline float Min(float a, float b) { return a < b ? a : b; }
+		inline float Max(float a, float b) { return a > b ? a : b; }
+
+		// For |x| < 2^31
+		inline float Floor(float x)
+		{
+			const float n = (float)(int)x;
+			return n > x ? n - 1.0f : n;
+		}
+
+		// x = m * 2^e with m in [0.5, 1), for positive x; 0 and denormals as
+		// the smallest normal
+		inline float Frexp(float x, float& e)
+		{
+			uint32_t bits = Bits(x);
+			if ((bits & 0x7f800000u) == 0)
+				bits = 0x00800000u;
+			e = (float)((int)(bits >> 23) - 126);
+			return FromBits((bits & 0x007fffffu) | 0x3f000000u);
+		}
+
+		// y * 2^n, for whole n in [-126, 127]
+		inline float Ldexp(float y, float n)
+		{
+			return y * FromBits((uint32_t)((int)n + 127) << 23);
+		}
+
+#if DSPMATH_SSE2
+		struct Float4
+		{
+			Float4() = default;
+			Float4(__m128 v) : v(v) {}
+			Float4(float c) : v(_mm_set1_ps(c)) {}
+			__m128 v;
+		};
+
+		inline Float4 operator + (Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+		inline Float4 operator - (Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+		inline Float4 operator * (Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+
+		inline Float4 Less(Float4 a, Float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+		inline Float4 Select(Float4 mask, Float4 a, Float4 b)
+		{
+			return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+		}
+		inline Float4 Min(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+		inline Float4 Max(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+
+		inline Float4 Floor(Float4 x)
+		{
+			const __m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(x.v));
+			return _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, x.v), _mm_set1_ps(1.0f)));
+		}
+
+		inline Float4 Frexp(Float4 x, Float4& e)
+		{
+			const __m128i subnormal = _mm_cmpeq_epi32(
+				_mm_and_si128(_mm_castps_si128(x.v), _mm_set1_epi32(0x7f800000)), _mm_setzero_si128());
+			const __m128i bits = _mm_or_si128(_mm_andnot_si128(subnormal, _mm_castps_si128(x.v)),
+				_mm_and_si128(subnormal, _mm_set1_epi32(0x00800000)));
+			e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+			return _mm_castsi128_ps(_mm_or_si128(
+				_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f000000)));
+		}
+
+		inline Float4 Ldexp(Float4 y, Float4 n)
+		{
+			const __m128i pow2n = _mm_slli_epi32(
+				_mm_add_epi32(_mm_cvttps_epi32(n.v), _mm_set1_epi32(127)), 23);
+			return _mm_mul_ps(y.v, _mm_castsi128_ps(pow2n));
+		}
+#endif
+
+		// x = (1 + m) * 2^e with 1 + m in [sqrt(0.5), sqrt(2)), and
+		// m^3 P(m) for the log of 1 + m in t, with z = m^2
+		template<typename V>
+		inline V LogReduce(V x, V& e, V& z, V& t)
+		{
+			V m = Frexp(x, e);
+			const auto low = Less(m, V(SQRT_HALF));
+			const V tmp = Select(low, m, V(0.0f));
+			m = m - V(1.0f);
+			e = e - Select(low, V(1.0f), V(0.0f));
+			m = m + tmp;
+
+			z = m * m;
+			V y = V(LOG_P0);
+			y = y * m + V(LOG_P1);
+			y = y * m + V(LOG_P2);
+			y = y * m + V(LOG_P3);
+			y = y * m + V(LOG_P4);
+			y = y * m + V(LOG_P5);
+			y = y * m + V(LOG_P6);
+			y = y * m + V(LOG_P7);
+			y = y * m + V(LOG_P8);
+			y = y * m;
+			t = y * z;
+			return m;
+		}
+
+		template<typename V>
+		inline V Log2Of(V x)
+		{
+			V e, z, t;
+			const V m = LogReduce(x, e, z, t);
+			const V y = t - z * V(0.5f);
+
+			// Scaled by log2(e) in two parts, keeping the exponent exact
+			V r = y * V(LOG2EA);
+			r = r + m * V(LOG2EA);
+			r = r + y;
+			r = r + m;
+			return r + e;
+		}
+
+		template<typename V>
+		inline V Log10Of(V x)
+		{
+			V e, z, t;
+			const V m = LogReduce(x, e, z, t);
+			const V y = t - z * V(0.5f);
+
+			V r = y * V(L10EB);
+			r = r + m * V(L10EB);
+			r = r + e * V(L102B);
+			r = r + y * V(L10EA);
+			r = r + m * V(L10EA);
+			return r + e * V(L102A);
+		}
+
+		template<typename V>
+		inline V Exp2Of(V x)
+		{
+			x = Min(x, V(EXP2_MAX));
+			x = Max(x, V(EXP2_MIN));
+
+			// x = n + r, |r| <= 0.5
+			const V n = Floor(x + V(0.5f));
+			const V r = x - n;
+
+			V p = V(EXP2_P0);
+			p = p * r + V(EXP2_P1);
+			p = p * r + V(EXP2_P2);
+			p = p * r + V(EXP2_P3);
+			p = p * r + V(EXP2_P4);
+			p = p * r + V(EXP2_P5);
+			p = p * r;
+			return Ldexp(p + V(1.0f), n);
+		}
+
+		// 10^r * 2^n for |r| <= log10(2) / 2
+		template<typename V>
+		inline V Pow10Reduced(V r, V n)
+		{
+			V p = V(POW10_P0);
+			p = p * r + V(POW10_P1);
+			p = p * r + V(POW10_P2);
+			p = p * r + V(POW10_P3);
+			p = p * r + V(POW10_P4);
+			p = p * r + V(POW10_P5);
+			p = p * r;
+			return Ldexp(p + V(1.0f), n);
+		}
+
+		template<typename V>
+		inline V Pow10Of(V x)
+		{
+			x = Min(x, V(POW10_MAX));
+			x = Max(x, V(POW10_MIN));
+
+			// x = n log10(2) + r
+			const V n = Floor(x * V(LOG210) + V(0.5f));
+			V r = x - n * V(L102A);
+			r = r - n * V(L102B);
+			return Pow10Reduced(r, n);
+		}
+
+		template<typename V>
+		inline V LinearToDbOf(V x) { return Log10Of(x) * V(20.0f); }
+
+		// The power of two comes out of the decibels themselves, so the
+		// scaling by 1/20 rounds only the small rest
+		template<typename V>
+		inline V DbToLinearOf(V db)
+		{
+			db = Min(db, V(20.0f * POW10_MAX));
+			db = Max(db, V(20.0f * POW10_MIN));
+
+			// db = 20 (n log10(2) + r)
+			const V n = Floor(db * V(0.05f * LOG210) + V(0.5f));
+			V r = db - n * V(DB2A);
+			r = r - n * V(DB2B);
+			return Pow10Reduced(r * V(0.05f), n);
+		}
+
+		template<typename Function>
+		inline void Map(const float* in, float* out, size_t count, Function function)
+		{
+			size_t ii = 0;
+#if DSPMATH_SSE2
+			for (; ii + 4 <= count; ii += 4)
+				_mm_storeu_ps(out + ii, function(Float4(_mm_loadu_ps(in + ii))).v);
+#endif
+			for (; ii < count; ++ii)
+				out[ii] = function(in[ii]);
+		}
+	}
+
+	inline float Log2(float x) { return Detail::Log2Of(x); }
+	inline float Log10(float x) { return Detail::Log10Of(x); }
+	inline float Exp2(float x) { return Detail::Exp2Of(x); }
+	inline float Pow10(float x) { return Detail::Pow10Of(x); }
+
+	// 20 log10 of an amplitude, and back
+	inline float LinearToDb(float x) { return Detail::LinearToDbOf(x); }
+	inline float DbToLinear(float db) { return Detail::DbToLinearOf(db); }
+
+	inline void Log2(const float* in, float* out, size_t count)
+	{
+		Detail::Map(in, out, count, [](auto x) { return Detail::Log2Of(x); });
+	}
+
+	inline void Log10(const float* in, float* out, size_t count)
+	{
+		Detail::Map(in, out, count, [](auto x) { return Detail::Log10Of(x); });
+	}
+
+	inline void Exp2(const float* in, float* out, size_t count)
+	{
+		Detail::Map(in, out, count, [](auto x) { return Detail::Exp2Of(x); });
+	}
+
+	inline void Pow10(const float* in, float* out, size_t count)
+	{
+		Detail::Map(in, out, count, [](auto x) { return Detail::Pow10Of(x); });
+	}
+
+	inline void LinearToDb(const float* in, float* out, size_t count)
+	{
+		Detail::Map(in, out, count, [](auto x) { return Detail::LinearToDbOf(x); });
+	}
+
+	inline void DbToLinear(const float* in, float* out, size_t count)
+	{
+		Detail::Map(in, out, count, [](auto x) { return Detail::DbToLinearOf(x); });
+	}
+}
@@ -1,26 +1,24 @@
 #include "InputTrack.h"
 
+#include <algorithm>
+#include <utility>
+
 InputTrack::InputTrack(const FloatVector& buffer) :
     mBuffer(buffer),
     mPosition(0)
 { }
 
+InputTrack::InputTrack(FloatVector&& buffer) :
+    mBuffer(std::move(buffer)),
+    mPosition(0)
+{ }
+
 size_t InputTrack::Read(float* buffer, size_t length)
 {
-    float* writePtr = buffer;
-    size_t totalRead = 0;
-
-    for (size_t i = 0; i < length; i++) {
-        if (mPosition >= mBuffer.size()) {
-            // reached end of this buffer
-            break;
-        }
-
-        *writePtr = mBuffer[mPosition];
-        mPosition++;
-        writePtr++;
-        totalRead++;
-    }
+    // Up to the end of this buffer
+    const size_t totalRead = std::min(length, mBuffer.size() - std::min(mPosition, mBuffer.size()));
+    std::copy_n(mBuffer.begin() + mPosition, totalRead, buffer);
+    mPosition += totalRead;
 
     return totalRead;
 }
\ No newline at end of file
@@ -6,6 +6,8 @@ class InputTrack
 {
 public:
     InputTrack(const FloatVector& buffer);
+    // Takes the samples over instead of copying them
+    InputTrack(FloatVector&& buffer);
     const FloatVector& Buffer() const { return mBuffer; }
     size_t Length() const { return mBuffer.size(); }
     size_t Read(float* buffer, size_t length);
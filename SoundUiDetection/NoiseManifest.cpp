@@ -0,0 +1,200 @@
+#include "NoiseManifest.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "WavReader.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	const char MAGIC[] = "NOISEMANIFEST";
+	const int VERSION = 1;
+
+	int64_t modifiedTime(const fs::path& path, std::error_code& ec)
+	{
+		const auto time = fs::last_write_time(path, ec);
+		return ec ? 0 : (int64_t)time.time_since_epoch().count();
+	}
+}
+
+NoiseManifest::NoiseManifest(std::string folder, std::string cachePath)
+	: mFolder(std::move(folder))
+	, mCachePath(std::move(cachePath))
+{
+	if (!mCachePath.empty() && load())
+		index();
+}
+
+unsigned NoiseManifest::Classify(const std::string& name)
+{
+	unsigned categories = 0;
+	if (name.find("rain") != std::string::npos || name.find("thunder") != std::string::npos)
+		categories |= CATEGORY_RAIN;
+	if (name.find("night") != std::string::npos)
+		categories |= CATEGORY_NIGHT;
+	return categories;
+}
+
+bool NoiseManifest::Refresh()
+{
+	std::error_code ec;
+	const fs::path folder(mFolder);
+	const int64_t folderModified = fs::is_directory(folder, ec) ? modifiedTime(folder, ec) : 0;
+
+	if (folderModified == 0)
+	{
+		mFolderModified = 0;
+		mFiles.clear();
+		index();
+		return false;
+	}
+
+	if (folderModified == mFolderModified)
+		return true;
+
+	// Files seen before with the same size and time keep their entry;
+	// only the rest are opened for their header
+	WavReader reader(1);
+	std::vector<File> files;
+	for (const auto& entry : fs::directory_iterator(folder, ec))
+	{
+		std::error_code entryEc;
+		if (!entry.is_regular_file(entryEc))
+			continue;
+
+		File file;
+		file.name = entry.path().filename().string();
+		file.size = entry.file_size(entryEc);
+		file.modified = modifiedTime(entry.path(), entryEc);
+
+		auto known = std::find_if(mFiles.begin(), mFiles.end(), [&file](const File& other)
+		{
+			return other.name == file.name && other.size == file.size && other.modified == file.modified;
+		});
+		if (known != mFiles.end())
+		{
+			files.push_back(*known);
+			continue;
+		}
+
+		if (!reader.Open(entry.path().string()))
+		{
+			std::cerr << "Not a sound file, left out: " << entry.path().string() << std::endl;
+			continue;
+		}
+
+		file.categories = Classify(file.name);
+		file.frames = reader.Frames();
+		file.channels = (int)reader.Channels();
+		file.rate = reader.Rate();
+		files.push_back(file);
+	}
+
+	std::sort(files.begin(), files.end(), [](const File& a, const File& b) { return a.name < b.name; });
+
+	mFiles = std::move(files);
+	mFolderModified = folderModified;
+	index();
+	save();
+	return true;
+}
+
+const std::vector<std::string>& NoiseManifest::ScenePaths(bool rain, bool night) const
+{
+	return mScenePaths[(rain ? (unsigned)CATEGORY_RAIN : 0u) | (night ? (unsigned)CATEGORY_NIGHT : 0u)];
+}
+
+void NoiseManifest::index()
+{
+	for (unsigned scene = 0; scene < 4; ++scene)
+	{
+		mScenePaths[scene].clear();
+
+		for (const auto& file : mFiles)
+		{
+			if (file.categories == 0 || (file.categories & scene) != 0)
+				mScenePaths[scene].push_back((fs::path(mFolder) / file.name).string());
+		}
+	}
+}
+
+bool NoiseManifest::load()
+{
+	std::ifstream in(mCachePath);
+	if (!in)
+		return false;
+
+	// A header line, then one line per file with the name last, as the
+	// only field that may hold spaces
+	std::string magic;
+	int version = 0;
+	int64_t folderModified = 0;
+	in >> magic >> version >> folderModified;
+	if (!in || magic != MAGIC || version != VERSION)
+		return false;
+
+	std::vector<File> files;
+	std::string line;
+	std::getline(in, line);
+	while (std::getline(in, line))
+	{
+		std::istringstream fields(line);
+		File file;
+		fields >> file.categories >> file.frames >> file.channels >> file.rate >> file.size >> file.modified;
+		if (fields && fields.get() == '\t')
+			std::getline(fields, file.name);
+		if (file.name.empty())
+		{
+			std::cerr << "Noise manifest " << mCachePath << " is damaged" << std::endl;
+			return false;
+		}
+		files.push_back(file);
+	}
+
+	mFiles = std::move(files);
+	mFolderModified = folderModified;
+	return true;
+}
+
+void NoiseManifest::save() const
+{
+	if (mCachePath.empty())
+		return;
+
+	const fs::path target(mCachePath);
+	const fs::path temporary(mCachePath + ".tmp");
+
+	std::error_code ec;
+	if (target.has_parent_path())
+		fs::create_directories(target.parent_path(), ec);
+
+	{
+		std::ofstream out(temporary, std::ios::trunc);
+		out << MAGIC << ' ' << VERSION << ' ' << mFolderModified << '\n';
+		for (const auto& file : mFiles)
+		{
+			out << file.categories << '\t' << file.frames << '\t' << file.channels << '\t' << file.rate << '\t'
+				<< file.size << '\t' << file.modified << '\t' << file.name << '\n';
+		}
+		if (!out)
+		{
+			std::cerr << "Failed to write noise manifest " << temporary.string() << std::endl;
+			out.close();
+			fs::remove(temporary, ec);
+			return;
+		}
+	}
+
+	// As in ProfileCache::Save, a reader never sees half a manifest
+	fs::rename(temporary, target, ec);
+	if (ec)
+	{
+		std::cerr << "Failed to replace noise manifest " << mCachePath << ": " << ec.message() << std::endl;
+		fs::remove(temporary, ec);
+	}
+}
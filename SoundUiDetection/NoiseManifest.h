@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The noise files of one map folder, each with its category and the facts
+// of its header, so choosing the files of a scene is an index lookup
+// instead of a walk of the folder.  The manifest is kept in a text file
+// between runs and rebuilt only when the folder's modification time moves,
+// which adding, removing or renaming a file does; only new or changed files
+// are opened then.  A file rewritten in place leaves the folder alone, but
+// ProfileLibrary still notices it by its digest.  Not thread-safe: each
+// manifest belongs to one thread.
+class NoiseManifest
+{
+public:
+	// Categories of a file, from its name; a file of neither is in every
+	// scene, one of both in a scene with either
+	enum Category : unsigned
+	{
+		CATEGORY_RAIN = 1,      // "rain" or "thunder"
+		CATEGORY_NIGHT = 2,     // "night"
+	};
+
+	struct File
+	{
+		std::string name;
+		unsigned categories;
+		int64_t frames;
+		int channels;
+		int rate;
+		uint64_t size;
+		int64_t modified;
+	};
+
+	// Without a cache path the manifest lives in memory only
+	explicit NoiseManifest(std::string folder, std::string cachePath = "");
+
+	// Rebuilds the manifest if the folder changed since it was made; false,
+	// and an empty manifest, when the folder does not exist
+	bool Refresh();
+
+	// Full paths of the files of a scene, in name order
+	const std::vector<std::string>& ScenePaths(bool rain, bool night) const;
+
+	const std::vector<File>& Files() const { return mFiles; }
+	const std::string& Folder() const { return mFolder; }
+
+	static unsigned Classify(const std::string& name);
+
+private:
+	bool load();
+	void save() const;
+	void index();
+
+	const std::string mFolder;
+	const std::string mCachePath;
+
+	// Modification time of the folder when the manifest was made, 0 for never
+	int64_t mFolderModified = 0;
+
+	// In name order
+	std::vector<File> mFiles;
+
+	// Indexed by rain | night << 1
+	std::vector<std::string> mScenePaths[4];
+};
@@ -32,7 +32,11 @@
 #include <exception>
 #include <string.h>
 #include <stdexcept>
+#include <numeric>
+#include <algorithm>
 
+#include "ChannelTeam.h"
+#include "DspMath.h"
 #include "RealFFTf.h"
 #include "Types.h"
 
@@ -63,6 +67,19 @@ enum WindowTypes {
 
 static const double DEFAULT_OLD_SENSITIVITY = 0.0;
 
+// Adaptive noise floor: the minima controlled recursive averaging (MCRA)
+// constants of Cohen and Berdugo, given as time constants so they hold
+// for any window and step size.
+static const double ADAPTIVE_POWER_TIME = 0.07;     // smoothing of the power, secs
+static const double ADAPTIVE_NOISE_TIME = 0.3;      // averaging of the noise, secs
+static const double ADAPTIVE_PRESENCE_TIME = 0.01;  // smoothing of the signal presence, secs
+static const double ADAPTIVE_MINIMUM_TIME = 1.0;    // minimum search span, secs
+static const float ADAPTIVE_PRESENCE_RATIO = 5.0f;  // power over the minimum that means signal
+// Floors that keep the decaying averages out of denormals, which are slow
+static const float ADAPTIVE_MIN_POWER = 1e-20f;     // -200 dB
+static const float ADAPTIVE_MIN_PRESENCE = 1e-6f;
+static const double DEFAULT_ADAPTIVE_WEIGHT = 0.5;
+
 const struct WindowTypesInfo {
     const char* name;
     unsigned minSteps;
@@ -126,33 +143,188 @@ public:
 #endif
 };
 
+// Noise floor followed from the signal itself, after MCRA: each bin's
+// power is smoothed and its minimum tracked over blocks of windows; where
+// the smoothed power stays near that minimum the bin is taken for noise
+// and the floor averages its power, and where it stands well above, the
+// floor holds.  Each window costs a few operations per bin, and no history
+// of windows is kept.  The floor estimates the mean power of the noise, as
+// the means of a profile do.
+class NoiseFloorTracker
+{
+public:
+    NoiseFloorTracker(size_t spectrumSize, double windowsPerSecond)
+        : mPowerSmoothing((float)exp(-1.0 / (ADAPTIVE_POWER_TIME * windowsPerSecond)))
+        , mNoiseSmoothing((float)exp(-1.0 / (ADAPTIVE_NOISE_TIME * windowsPerSecond)))
+        , mPresenceSmoothing((float)exp(-1.0 / (ADAPTIVE_PRESENCE_TIME * windowsPerSecond)))
+        , mMinimumWindows(std::max(1u, (unsigned)(ADAPTIVE_MINIMUM_TIME * windowsPerSecond)))
+        , mWindows(0)
+        , mStarted(false)
+        , mSmoothed(spectrumSize)
+        , mMinimum(spectrumSize)
+        , mSearchMinimum(spectrumSize)
+        , mPresence(spectrumSize)
+        , mNoise(spectrumSize)
+    {}
+
+    // Power spectrum of the newest window
+    void Update(const float* power)
+    {
+        const size_t size = mNoise.size();
+
+        // The floor starts from the first window that is not silence,
+        // taken to be all noise
+        if (!mStarted) {
+            if (std::all_of(power, power + size, [](float p) { return p == 0.0f; }))
+                return;
+            std::copy(power, power + size, mSmoothed.begin());
+            std::copy(power, power + size, mMinimum.begin());
+            std::copy(power, power + size, mSearchMinimum.begin());
+            std::copy(power, power + size, mNoise.begin());
+            mStarted = true;
+            return;
+        }
+
+        const float powerSmoothing = mPowerSmoothing;
+        const float noiseSmoothing = mNoiseSmoothing;
+        const float presenceSmoothing = mPresenceSmoothing;
+        float* const pSmoothed = &mSmoothed[0];
+        float* const pMinimum = &mMinimum[0];
+        float* const pSearchMinimum = &mSearchMinimum[0];
+        float* const pPresence = &mPresence[0];
+        float* const pNoise = &mNoise[0];
+
+        // Two passes with selects on values, rather than one with std::min
+        // and std::max on references, so that each vectorizes
+        for (size_t jj = 0; jj < size; ++jj) {
+            float smoothed = powerSmoothing * pSmoothed[jj] + (1.0f - powerSmoothing) * power[jj];
+            smoothed = smoothed > ADAPTIVE_MIN_POWER ? smoothed : ADAPTIVE_MIN_POWER;
+            pSmoothed[jj] = smoothed;
+            pMinimum[jj] = pMinimum[jj] < smoothed ? pMinimum[jj] : smoothed;
+            pSearchMinimum[jj] = pSearchMinimum[jj] < smoothed ? pSearchMinimum[jj] : smoothed;
+        }
+
+        for (size_t jj = 0; jj < size; ++jj) {
+            const float present = pSmoothed[jj] > ADAPTIVE_PRESENCE_RATIO * pMinimum[jj] ? 1.0f : 0.0f;
+            float presence = presenceSmoothing * pPresence[jj] + (1.0f - presenceSmoothing) * present;
+            presence = presence < ADAPTIVE_MIN_PRESENCE ? 0.0f : presence;
+            pPresence[jj] = presence;
+
+            // Where signal is likely, the floor barely moves
+            const float smoothing = noiseSmoothing + (1.0f - noiseSmoothing) * presence;
+            const float noise = smoothing * pNoise[jj] + (1.0f - smoothing) * power[jj];
+            pNoise[jj] = noise > ADAPTIVE_MIN_POWER ? noise : ADAPTIVE_MIN_POWER;
+        }
+
+        // At the end of each span the minimum restarts from the one found
+        // in it, so the floor can rise again within two spans
+        if (++mWindows == mMinimumWindows) {
+            mWindows = 0;
+            for (size_t jj = 0; jj < size; ++jj) {
+                mMinimum[jj] = std::min(mSearchMinimum[jj], mSmoothed[jj]);
+                mSearchMinimum[jj] = mSmoothed[jj];
+            }
+        }
+    }
+
+    bool Started() const { return mStarted; }
+    const FloatVector& Means() const { return mNoise; }
+
+private:
+    const float mPowerSmoothing;
+    const float mNoiseSmoothing;
+    const float mPresenceSmoothing;
+    const unsigned mMinimumWindows;
+    unsigned mWindows;
+    bool mStarted;
+
+    FloatVector mSmoothed;
+    FloatVector mMinimum;
+    FloatVector mSearchMinimum;
+    FloatVector mPresence;
+    FloatVector mNoise;
+};
+
+// Window processing comes in shapes.  The generic shape takes every size
+// and choice from the settings; the fixed ones have them as constants for
+// the configurations run live, so that their loops have constant trip
+// counts and no tests of the settings inside, for the compiler to unroll
+// and vectorize.  The worker picks its shape once, when it is made.
+struct GenericShape
+{
+    static constexpr bool Fixed = false;
+    static constexpr size_t WindowSize = 0;
+    static constexpr unsigned StepsPerWindow = 0;
+    static constexpr int Method = DM_DEFAULT_METHOD;
+};
+
+// Hann windows in and out, four steps a window and the second greatest
+// method, the defaults
+template<size_t Size>
+struct HannHannShape
+{
+    static constexpr bool Fixed = true;
+    static constexpr size_t WindowSize = Size;
+    static constexpr unsigned StepsPerWindow = 4;
+    static constexpr int Method = DM_SECOND_GREATEST;
+};
+
 // This object holds information needed only during effect calculation
 class NoiseReductionWorker
 {
 public:
     typedef NoiseReduction::Settings Settings;
-    typedef Statistics Statistics;
 
     NoiseReductionWorker(const NoiseReduction::Settings& settings, double sampleRate
 #ifdef EXPERIMENTAL_SPECTRAL_EDITING
         , double f0, double f1
 #endif
+        , size_t channels = 1
     );
     NoiseReductionWorker();
 
     bool ProcessOne(Statistics& statistics, InputTrack& track, OutputTrack* outputTrack);
 
+    // Streaming use: StartStream once, then any number of ProcessStream
+    // calls of blockSize frames each.  Channel cc of the input starts at
+    // inputs[cc] and has its samples inStride floats apart, so planar
+    // (stride 1) and interleaved (stride = channels) data both work;
+    // likewise for the outputs.
+    void StartStream(size_t blockSize);
+    void ProcessStream(Statistics& statistics,
+        const float* const* inputs, size_t inStride,
+        float* const* outputs, size_t outStride, size_t len);
+    size_t StreamLatency(size_t blockSize) const;
+
+    // Profiling use: StartProfileTrack, then any number of ProfileSamples
+    // calls with chunks of any length, then FinishProfileTrack; again for
+    // every further track.  Only a window of samples is held between calls,
+    // and the statistics gather the windows of all the tracks and channels.
+    // The buffer holds len frames of interleaved channels.
+    void StartProfileTrack();
+    void ProfileSamples(Statistics& statistics, const float* buffer, size_t len);
+    void FinishProfileTrack(Statistics& statistics);
+
 private:
 
+    struct Channel;
+
     void StartNewTrack();
     void ProcessSamples(Statistics& statistics,
-        float* buffer, size_t len, OutputTrack* outputTrack);
-    void FillFirstHistoryWindow();
-    void ApplyFreqSmoothing(FloatVector& gains);
-    void GatherStatistics(Statistics& statistics);
-    inline bool Classify(const Statistics& statistics, unsigned nWindows, int band);
-    void ReduceNoise(const Statistics& statistics, OutputTrack* outputTrack);
-    void RotateHistoryWindows();
+        const float* const* buffers, size_t stride, size_t len, OutputTrack* outputTrack);
+    template<typename Shape> void ProcessWindow(Statistics& statistics, OutputTrack* outputTrack);
+    template<typename Job> void ForEachChannel(Job& job);
+    void EmitStep(Channel& channel, const float* buffer, OutputTrack* outputTrack);
+    template<typename Shape> void FillFirstHistoryWindow(Channel& channel);
+    void ApplyFreqSmoothing(Channel& channel, float* gains);
+    void GatherStatistics(Statistics& statistics, Channel& channel);
+    // The noise means the gains of the channel are measured against
+    const float* NoiseMeans(const Statistics& statistics, Channel& channel);
+    template<typename Shape> void Classify(const float* means, Channel& channel, unsigned nWindows, float* gains);
+    template<typename Shape> void ComputeGains(const Statistics& statistics, Channel& channel);
+    void LinkGains();
+    template<typename Shape> void SynthesizeStep(Channel& channel, OutputTrack* outputTrack);
+    void RotateHistoryWindows(Channel& channel);
     void FinishTrackStatistics(Statistics& statistics);
     void FinishTrack(Statistics& statistics, OutputTrack* outputTrack);
 
@@ -165,15 +337,11 @@ private:
     const size_t mWindowSize;
     // These have that size:
     HFFT     hFFT;
-    FloatVector mFFTBuffer;
-    FloatVector mInWaveBuffer;
-    FloatVector mOutOverlapBuffer;
     // These have that size, or 0:
     FloatVector mInWindow;
     FloatVector mOutWindow;
 
     const size_t mSpectrumSize;
-    FloatVector mFreqSmoothingScratch;
     const size_t mFreqSmoothingBins;
     // When spectral selection limits the affected band:
     int mBinLow;  // inclusive lower bound
@@ -185,6 +353,14 @@ private:
     const int mMethod;
     const double mNewSensitivity;
 
+    const bool mLinkChannels;
+    const bool mParallelChannels;
+    // Streams with parallel channels only, from StartStream on
+    std::unique_ptr<ChannelTeam> mTeam;
+
+    // Weight of the adaptive floor against the profile, when both exist
+    const bool mAdaptiveNoise;
+    const float mAdaptiveWeight;
 
     sampleCount       mInSampleCount;
     sampleCount       mOutStepCount;
@@ -199,25 +375,179 @@ private:
     unsigned  mCenter;
     unsigned  mHistoryLen;
 
-    struct Record
+    // ProcessWindow for the shape of the settings
+    void (NoiseReductionWorker::*mProcessWindow)(Statistics& statistics, OutputTrack* outputTrack);
+
+    // The sliding history of windows of a channel: power spectrums, gains
+    // and the real and imaginary parts of the transforms, as four
+    // [history][bins] matrices in one aligned arena.  Row 0 is the newest
+    // window and row historyLen - 1 the oldest; the rows form a ring, so
+    // moving to the next window moves the start of the ring instead of
+    // any data.  Rows start on cache lines, and every pass over a row is a
+    // unit-stride loop over bins.
+    class History
+    {
+    public:
+        History(size_t spectrumSize, unsigned historyLen)
+            : mLength(historyLen)
+            , mStride((spectrumSize + FLOATS_PER_LINE - 1) / FLOATS_PER_LINE * FLOATS_PER_LINE)
+            , mStart(0)
+        {
+            mArena.reinit(MATRICES * mLength * mStride);
+            std::fill(mArena.get(), mArena.get() + MATRICES * mLength * mStride, 0.0f);
+        }
+
+        float* Spectrum(unsigned ii) const { return Row(SPECTRUMS, ii); }
+        float* Gains(unsigned ii) const { return Row(GAINS, ii); }
+        float* Real(unsigned ii) const { return Row(REAL, ii); }
+        float* Imag(unsigned ii) const { return Row(IMAG, ii); }
+
+        // The oldest row becomes the newest, to be filled by the next window
+        void Rotate() { mStart = (mStart == 0 ? mLength : mStart) - 1; }
+
+    private:
+        enum { SPECTRUMS, GAINS, REAL, IMAG, MATRICES };
+        static constexpr size_t FLOATS_PER_LINE = AlignedArrayOf<float>::Alignment / sizeof(float);
+
+        float* Row(int matrix, unsigned ii) const
+        {
+            unsigned row = mStart + ii;
+            if (row >= mLength)
+                row -= mLength;
+            return mArena.get() + (matrix * mLength + row) * mStride;
+        }
+
+        const unsigned mLength;
+        const size_t mStride;
+        unsigned mStart;
+        AlignedArrayOf<float> mArena;
+    };
+
+    // The powers of the windows Classify examines, sorted in every bin, for
+    // the median of more windows than its ranks keep.  The windows slide by
+    // one each step, so one power enters each bin and one leaves, each in a
+    // pass over the sorted rows that compares and selects without branches;
+    // every pass is a unit-stride loop over bins.  Row 0 holds the least
+    // power of each bin.  Between windows the rows hold all the examined
+    // windows but the newest.
+    class SlidingMedian
     {
-        Record(size_t spectrumSize)
-            : mSpectrums(spectrumSize)
-            , mGains(spectrumSize)
-            , mRealFFTs(spectrumSize - 1)
-            , mImagFFTs(spectrumSize - 1)
+    public:
+        SlidingMedian(size_t spectrumSize, unsigned windows)
+            : mWindows(windows)
+            , mSize(spectrumSize)
+            , mStride((spectrumSize + FLOATS_PER_LINE - 1) / FLOATS_PER_LINE * FLOATS_PER_LINE)
+        {
+            mSorted.reinit(mWindows * mStride);
+            Reset();
+        }
+
+        // As for a history of silence
+        void Reset()
+        {
+            std::fill(mSorted.get(), mSorted.get() + mWindows * mStride, 0.0f);
+        }
+
+        // Sorts in the powers of the newest window.  Each row becomes the
+        // lesser of itself and the greater of the row below and the new
+        // power; going up from the top, every row reads the one below
+        // before it changes.
+        void Insert(const float* power)
+        {
+            {
+                float* pRow = Row(mWindows - 1);
+                const float* pBelow = Row(mWindows - 2);
+                for (size_t jj = 0; jj < mSize; ++jj)
+                    pRow[jj] = pBelow[jj] < power[jj] ? power[jj] : pBelow[jj];
+            }
+            for (unsigned ii = mWindows - 2; ii > 0; --ii) {
+                float* pRow = Row(ii);
+                const float* pBelow = Row(ii - 1);
+                for (size_t jj = 0; jj < mSize; ++jj) {
+                    const float floor = pBelow[jj] < power[jj] ? power[jj] : pBelow[jj];
+                    pRow[jj] = pRow[jj] < floor ? pRow[jj] : floor;
+                }
+            }
+            {
+                float* pRow = Row(0);
+                for (size_t jj = 0; jj < mSize; ++jj)
+                    pRow[jj] = pRow[jj] < power[jj] ? pRow[jj] : power[jj];
+            }
+        }
+
+        // After Insert; the number of windows is odd
+        const float* Median() const { return Row(mWindows / 2); }
+
+        // Takes out the powers of the oldest window examined.  The rows
+        // from the first not below the power move down one; going down
+        // from the bottom, every row reads the one above before it changes.
+        void Remove(const float* power)
         {
+            for (unsigned ii = 0; ii + 1 < mWindows; ++ii) {
+                float* pRow = Row(ii);
+                const float* pAbove = Row(ii + 1);
+                for (size_t jj = 0; jj < mSize; ++jj)
+                    pRow[jj] = pRow[jj] < power[jj] ? pRow[jj] : pAbove[jj];
+            }
         }
 
-        FloatVector mSpectrums;
-        FloatVector mGains;
-        FloatVector mRealFFTs;
-        FloatVector mImagFFTs;
+    private:
+        static constexpr size_t FLOATS_PER_LINE = AlignedArrayOf<float>::Alignment / sizeof(float);
+
+        float* Row(unsigned ii) const { return mSorted.get() + ii * mStride; }
+
+        const unsigned mWindows;
+        const size_t mSize;
+        const size_t mStride;
+        AlignedArrayOf<float> mSorted;
     };
-    std::vector<movable_ptr<Record>> mQueue;
+
+    // Everything that differs between channels.  Windows, FFT tables and
+    // settings are shared, and all channels step through their windows
+    // together, so gains can be compared across channels at each step.
+    struct Channel
+    {
+        Channel(size_t windowSize, size_t spectrumSize, unsigned historyLen)
+            : mFFTBuffer(windowSize)
+            , mInWaveBuffer(windowSize)
+            , mOutOverlapBuffer(windowSize)
+            , mFreqSmoothingScratch(spectrumSize)
+            , mSynthReal(spectrumSize)
+            , mSynthImag(spectrumSize)
+            , mHistory(spectrumSize, historyLen)
+            , mStreamOutputLen(0)
+        {
+        }
+
+        // These have the window size:
+        FloatVector mFFTBuffer;
+        FloatVector mInWaveBuffer;
+        FloatVector mOutOverlapBuffer;
+
+        FloatVector mFreqSmoothingScratch;
+
+        // Gained spectrum for the inverse FFT, spectrum size
+        FloatVector mSynthReal;
+        FloatVector mSynthImag;
+
+        History mHistory;
+
+        // Finished output steps not yet handed back by ProcessStream
+        FloatVector mStreamOutput;
+        size_t mStreamOutputLen;
+
+        // With an adaptive noise floor only: the tracker, and the means
+        // for the current window
+        std::unique_ptr<NoiseFloorTracker> mTracker;
+        FloatVector mNoiseMeans;
+
+        // When isolating noise by the median of more than five windows
+        std::unique_ptr<SlidingMedian> mMedian;
+    };
+    std::vector<Channel> mChannels;
 };
 
-void NoiseReductionWorker::ApplyFreqSmoothing(FloatVector& gains)
+void NoiseReductionWorker::ApplyFreqSmoothing(Channel& channel, float* gains)
 {
     // Given an array of gain mutipliers, average them
     // GEOMETRICALLY.  Don't multiply and take nth root --
@@ -226,25 +556,32 @@ void NoiseReductionWorker::ApplyFreqSmoothing(FloatVector& gains)
     if (mFreqSmoothingBins == 0)
         return;
 
-    {
-        float* pScratch = &mFreqSmoothingScratch[0];
-        std::fill(pScratch, pScratch + mSpectrumSize, 0.0f);
+    // Any base will do, and 2 is the cheapest
+    float* const logs = &channel.mFreqSmoothingScratch[0];
+    DspMath::Log2(gains, logs, mSpectrumSize);
+
+    // The window of each bin is the window of the one before moved up a
+    // bin, so keep the sum of its logs running, adding the log that comes
+    // in and dropping the one that goes out; the cost does not depend on
+    // the width.  The sum is double so it does not drift over the bins.
+    const int last = (int)mSpectrumSize - 1;
+    const int width = (int)mFreqSmoothingBins;
+    double sum = 0.0;
+    for (int jj = 0; jj <= std::min(last, width); ++jj)
+        sum += logs[jj];
+
+    for (int ii = 0; ii <= last; ++ii) {
+        const int j0 = std::max(0, ii - width);
+        const int j1 = std::min(last, ii + width);
+        gains[ii] = (float)(sum / (j1 - j0 + 1));
+
+        if (ii + width < last)
+            sum += logs[ii + width + 1];
+        if (ii - width >= 0)
+            sum -= logs[ii - width];
     }
 
-    for (size_t ii = 0; ii < mSpectrumSize; ++ii)
-        gains[ii] = log(gains[ii]);
-
-    for (int ii = 0; (size_t)ii < mSpectrumSize; ++ii) {
-        const int j0 = std::max(0, ii - (int)mFreqSmoothingBins);
-        const int j1 = std::min(mSpectrumSize - 1, ii + mFreqSmoothingBins);
-        for (int jj = j0; jj <= j1; ++jj) {
-            mFreqSmoothingScratch[ii] += gains[jj];
-        }
-        mFreqSmoothingScratch[ii] /= (j1 - j0 + 1);
-    }
-
-    for (size_t ii = 0; ii < mSpectrumSize; ++ii)
-        gains[ii] = exp(mFreqSmoothingScratch[ii]);
+    DspMath::Exp2(gains, gains, mSpectrumSize);
 }
 
 NoiseReductionWorker::NoiseReductionWorker
@@ -252,21 +589,18 @@ NoiseReductionWorker::NoiseReductionWorker
 #ifdef EXPERIMENTAL_SPECTRAL_EDITING
     , double f0, double f1
 #endif
+    , size_t channels
 )
     : mDoProfile(settings.mDoProfile)
 
     , mSampleRate(sampleRate)
 
     , mWindowSize(settings.WindowSize())
-    , hFFT(GetFFT(mWindowSize))
-    , mFFTBuffer(mWindowSize)
-    , mInWaveBuffer(mWindowSize)
-    , mOutOverlapBuffer(mWindowSize)
+    , hFFT(GetFFT(mWindowSize, FFTVariant::Ordered))
     , mInWindow()
     , mOutWindow()
 
     , mSpectrumSize(1 + mWindowSize / 2)
-    , mFreqSmoothingScratch(mSpectrumSize)
     , mFreqSmoothingBins((int)(settings.mFreqSmoothingBands))
     , mBinLow(0)
     , mBinHigh(mSpectrumSize)
@@ -279,6 +613,12 @@ NoiseReductionWorker::NoiseReductionWorker
     // Sensitivity setting is a base 10 log, turn it into a natural log
     , mNewSensitivity(settings.mNewSensitivity* log(10.0))
 
+    , mLinkChannels(settings.mLinkChannels)
+    , mParallelChannels(settings.mParallelChannels)
+
+    , mAdaptiveNoise(settings.mAdaptiveNoise && !settings.mDoProfile)
+    , mAdaptiveWeight((float)std::clamp(settings.mAdaptiveWeight, 0.0, 1.0))
+
     , mInSampleCount(0)
     , mOutStepCount(0)
     , mInWavePos(0)
@@ -324,9 +664,42 @@ NoiseReductionWorker::NoiseReductionWorker
         mHistoryLen = std::max(mNWindowsToExamine, mCenter + nAttackBlocks);
     }
 
-    mQueue.resize(mHistoryLen);
-    for (unsigned ii = 0; ii < mHistoryLen; ++ii)
-        mQueue[ii] = make_movable<Record>(mSpectrumSize);
+    // Profiling has no synthesis window, and spectral selection limits the
+    // bins, so both take the generic shape
+    mProcessWindow = &NoiseReductionWorker::ProcessWindow<GenericShape>;
+    if (!mDoProfile && settings.mWindowTypes == WT_HANN_HANN && mStepsPerWindow == 4 &&
+        mMethod == DM_SECOND_GREATEST && mBinLow == 0 && mBinHigh == (int)mSpectrumSize) {
+        switch (mWindowSize) {
+        case 2048:
+            mProcessWindow = &NoiseReductionWorker::ProcessWindow<HannHannShape<2048>>;
+            break;
+        case 1024:
+            mProcessWindow = &NoiseReductionWorker::ProcessWindow<HannHannShape<1024>>;
+            break;
+        case 512:
+            mProcessWindow = &NoiseReductionWorker::ProcessWindow<HannHannShape<512>>;
+            break;
+        default:
+            break;
+        }
+    }
+
+    mChannels.reserve(channels);
+    for (size_t ii = 0; ii < channels; ++ii)
+        mChannels.emplace_back(mWindowSize, mSpectrumSize, mHistoryLen);
+
+    if (mAdaptiveNoise) {
+        for (auto& channel : mChannels) {
+            channel.mTracker = std::make_unique<NoiseFloorTracker>(mSpectrumSize, mSampleRate / mStepSize);
+            channel.mNoiseMeans.resize(mSpectrumSize);
+        }
+    }
+
+    if (!mDoProfile && mNoiseReductionChoice == NRC_ISOLATE_NOISE &&
+        mMethod == DM_MEDIAN && mNWindowsToExamine > 5) {
+        for (auto& channel : mChannels)
+            channel.mMedian = std::make_unique<SlidingMedian>(mSpectrumSize, mNWindowsToExamine);
+    }
 
     // Create windows
 
@@ -396,27 +769,31 @@ NoiseReductionWorker::NoiseReductionWorker
 void NoiseReductionWorker::StartNewTrack()
 {
     float* pFill;
-    for (unsigned ii = 0; ii < mHistoryLen; ++ii) {
-        Record& record = *mQueue[ii];
+    for (auto& channel : mChannels) {
+        const History& history = channel.mHistory;
+        for (unsigned ii = 0; ii < mHistoryLen; ++ii) {
+            pFill = history.Spectrum(ii);
+            std::fill(pFill, pFill + mSpectrumSize, 0.0f);
 
-        pFill = &record.mSpectrums[0];
-        std::fill(pFill, pFill + mSpectrumSize, 0.0f);
+            pFill = history.Real(ii);
+            std::fill(pFill, pFill + mSpectrumSize, 0.0f);
 
-        pFill = &record.mRealFFTs[0];
-        std::fill(pFill, pFill + mSpectrumSize - 1, 0.0f);
+            pFill = history.Imag(ii);
+            std::fill(pFill, pFill + mSpectrumSize, 0.0f);
 
-        pFill = &record.mImagFFTs[0];
-        std::fill(pFill, pFill + mSpectrumSize - 1, 0.0f);
+            pFill = history.Gains(ii);
+            std::fill(pFill, pFill + mSpectrumSize, mNoiseAttenFactor);
+        }
 
-        pFill = &record.mGains[0];
-        std::fill(pFill, pFill + mSpectrumSize, mNoiseAttenFactor);
-    }
+        pFill = &channel.mOutOverlapBuffer[0];
+        std::fill(pFill, pFill + mWindowSize, 0.0f);
 
-    pFill = &mOutOverlapBuffer[0];
-    std::fill(pFill, pFill + mWindowSize, 0.0f);
+        pFill = &channel.mInWaveBuffer[0];
+        std::fill(pFill, pFill + mWindowSize, 0.0f);
 
-    pFill = &mInWaveBuffer[0];
-    std::fill(pFill, pFill + mWindowSize, 0.0f);
+        if (channel.mMedian)
+            channel.mMedian->Reset();
+    }
 
     if (mDoProfile)
     {
@@ -441,81 +818,133 @@ void NoiseReductionWorker::StartNewTrack()
 }
 
 void NoiseReductionWorker::ProcessSamples
-(Statistics& statistics, float* buffer, size_t len, OutputTrack* outputTrack)
+(Statistics& statistics, const float* const* buffers, size_t stride, size_t len, OutputTrack* outputTrack)
 {
+    size_t offset = 0;
     while (len && mOutStepCount * mStepSize < mInSampleCount) {
         auto avail = std::min(len, mWindowSize - mInWavePos);
-        memmove(&mInWaveBuffer[mInWavePos], buffer, avail * sizeof(float));
-        buffer += avail;
+        for (size_t cc = 0, nn = mChannels.size(); cc < nn; ++cc) {
+            const float* pIn = buffers[cc] + offset * stride;
+            float* pWave = &mChannels[cc].mInWaveBuffer[mInWavePos];
+            if (stride == 1)
+                memmove(pWave, pIn, avail * sizeof(float));
+            else
+                for (size_t ii = 0; ii < avail; ++ii, pIn += stride)
+                    *pWave++ = *pIn;
+        }
+        offset += avail;
         len -= avail;
         mInWavePos += avail;
 
         if (mInWavePos == (int)mWindowSize) {
-            FillFirstHistoryWindow();
-            if (mDoProfile)
-                GatherStatistics(statistics);
-            else
-                ReduceNoise(statistics, outputTrack);
+            (this->*mProcessWindow)(statistics, outputTrack);
             ++mOutStepCount;
-            RotateHistoryWindows();
 
-            // Rotate for overlap-add
-            memmove(&mInWaveBuffer[0], &mInWaveBuffer[mStepSize],
-                (mWindowSize - mStepSize) * sizeof(float));
+            for (auto& channel : mChannels) {
+                RotateHistoryWindows(channel);
+
+                // Rotate for overlap-add
+                memmove(&channel.mInWaveBuffer[0], &channel.mInWaveBuffer[mStepSize],
+                    (mWindowSize - mStepSize) * sizeof(float));
+            }
             mInWavePos -= mStepSize;
         }
     }
 }
 
-void NoiseReductionWorker::FillFirstHistoryWindow()
+template<typename Shape>
+void NoiseReductionWorker::ProcessWindow(Statistics& statistics, OutputTrack* outputTrack)
+{
+    // Each channel's analysis and gain decisions are independent, so they
+    // may run on separate cores; otherwise the channels are visited in turn
+    // while the window and gain tables are still in cache.
+    const size_t nChannels = mChannels.size();
+
+    auto analyze = [this, &statistics](size_t cc) {
+        FillFirstHistoryWindow<Shape>(mChannels[cc]);
+        if (!mDoProfile)
+            ComputeGains<Shape>(statistics, mChannels[cc]);
+    };
+    ForEachChannel(analyze);
+
+    if (mDoProfile) {
+        // All channels add into the same sums
+        for (auto& channel : mChannels)
+            GatherStatistics(statistics, channel);
+        return;
+    }
+
+    if (mOutStepCount < -(int)(mStepsPerWindow - 1))
+        return;
+
+    if (mLinkChannels && nChannels > 1)
+        LinkGains();
+
+    auto synthesize = [this, outputTrack](size_t cc) {
+        SynthesizeStep<Shape>(mChannels[cc], outputTrack);
+    };
+    ForEachChannel(synthesize);
+}
+
+template<typename Job>
+void NoiseReductionWorker::ForEachChannel(Job& job)
+{
+    // A stream wakes the team it started, as forking threads on every hop
+    // would cost the audio thread more than the channels save.  Offline
+    // work may take a team from OpenMP for each window.
+    if (mTeam) {
+        mTeam->Run(job);
+        return;
+    }
+
+    const int nChannels = (int)mChannels.size();
+#pragma omp parallel for if(mParallelChannels && nChannels > 1)
+    for (int cc = 0; cc < nChannels; ++cc)
+        job((size_t)cc);
+}
+
+template<typename Shape>
+void NoiseReductionWorker::FillFirstHistoryWindow(Channel& channel)
 {
+    const size_t windowSize = Shape::Fixed ? Shape::WindowSize : mWindowSize;
+    const size_t spectrumSize = windowSize / 2 + 1;
+
+    FloatVector& fftBuffer = channel.mFFTBuffer;
+    const FloatVector& inWaveBuffer = channel.mInWaveBuffer;
+
     // Transform samples to frequency domain, windowed as needed
-    if (mInWindow.size() > 0)
-        for (size_t ii = 0; ii < mWindowSize; ++ii)
-            mFFTBuffer[ii] = mInWaveBuffer[ii] * mInWindow[ii];
+    if (Shape::Fixed || mInWindow.size() > 0)
+        for (size_t ii = 0; ii < windowSize; ++ii)
+            fftBuffer[ii] = inWaveBuffer[ii] * mInWindow[ii];
     else
-        memmove(&mFFTBuffer[0], &mInWaveBuffer[0], mWindowSize * sizeof(float));
+        memmove(&fftBuffer[0], &inWaveBuffer[0], windowSize * sizeof(float));
 
-    RealFFTf(&mFFTBuffer[0], hFFT.get());
+    const History& history = channel.mHistory;
 
-    Record& record = *mQueue[0];
-
-    // Store real and imaginary parts for later inverse FFT, and compute
-    // power
+    // Store real and imaginary parts for later inverse FFT, in natural
+    // order straight from the transform (DC and Fs/2 have zero imaginary
+    // parts), and compute power
+    RealFFTfOrdered(hFFT.get(), &fftBuffer[0], history.Real(0), history.Imag(0));
     {
-        float* pReal = &record.mRealFFTs[1];
-        float* pImag = &record.mImagFFTs[1];
-        float* pPower = &record.mSpectrums[1];
-        int* pBitReversed = &hFFT->BitReversed[1];
-        const auto last = mSpectrumSize - 1;
-        for (unsigned int ii = 1; ii < last; ++ii) {
-            const int kk = *pBitReversed++;
-            const float realPart = *pReal++ = mFFTBuffer[kk];
-            const float imagPart = *pImag++ = mFFTBuffer[kk + 1];
-            *pPower++ = realPart * realPart + imagPart * imagPart;
-        }
-        // DC and Fs/2 bins need to be handled specially
-        const float dc = mFFTBuffer[0];
-        record.mRealFFTs[0] = dc;
-        record.mSpectrums[0] = dc * dc;
-
-        const float nyquist = mFFTBuffer[1];
-        record.mImagFFTs[0] = nyquist; // For Fs/2, not really imaginary
-        record.mSpectrums[last] = nyquist * nyquist;
+        const float* pReal = history.Real(0);
+        const float* pImag = history.Imag(0);
+        float* pPower = history.Spectrum(0);
+        for (size_t ii = 0; ii < spectrumSize; ++ii)
+            pPower[ii] = pReal[ii] * pReal[ii] + pImag[ii] * pImag[ii];
     }
 
     if (mNoiseReductionChoice != NRC_ISOLATE_NOISE)
     {
         // Default all gains to the reduction factor,
         // until we decide to raise some of them later
-        float* pGain = &record.mGains[0];
-        std::fill(pGain, pGain + mSpectrumSize, mNoiseAttenFactor);
+        float* pGain = history.Gains(0);
+        std::fill(pGain, pGain + spectrumSize, mNoiseAttenFactor);
     }
 }
 
-void NoiseReductionWorker::RotateHistoryWindows()
+void NoiseReductionWorker::RotateHistoryWindows(Channel& channel)
 {
-    std::rotate(mQueue.begin(), mQueue.end() - 1, mQueue.end());
+    channel.mHistory.Rotate();
 }
 
 void NoiseReductionWorker::FinishTrackStatistics(Statistics& statistics)
@@ -550,19 +979,22 @@ void NoiseReductionWorker::FinishTrack
     // We'll DELETE them later in ProcessOne.
 
     FloatVector empty(mStepSize);
+    std::vector<const float*> buffers(mChannels.size(), &empty[0]);
 
     while (mOutStepCount * mStepSize < mInSampleCount) {
-        ProcessSamples(statistics, &empty[0], mStepSize, outputTrack);
+        ProcessSamples(statistics, buffers.data(), 1, mStepSize, outputTrack);
     }
 }
 
-void NoiseReductionWorker::GatherStatistics(Statistics& statistics)
+void NoiseReductionWorker::GatherStatistics(Statistics& statistics, Channel& channel)
 {
+    const History& history = channel.mHistory;
+
     ++statistics.mTrackWindows;
 
     {
         // NEW statistics
-        auto pPower = &mQueue[0]->mSpectrums[0];
+        auto pPower = history.Spectrum(0);
         auto pSum = &statistics.mSums[0];
         for (size_t jj = 0; jj < mSpectrumSize; ++jj) {
             *pSum++ += *pPower++;
@@ -578,12 +1010,12 @@ void NoiseReductionWorker::GatherStatistics(Statistics& statistics)
 
     {
         // old statistics
-        auto pPower = &mQueue[0]->mSpectrums[0];
+        auto pPower = history.Spectrum(0);
         auto pThreshold = &statistics.mNoiseThreshold[0];
         for (int jj = 0; jj < mSpectrumSize; ++jj) {
             float min = *pPower++;
             for (unsigned ii = 1; ii < finish; ++ii)
-                min = std::min(min, mQueue[ii]->mSpectrums[jj]);
+                min = std::min(min, history.Spectrum(ii)[jj]);
             *pThreshold = std::max(*pThreshold, min);
             ++pThreshold;
         }
@@ -591,12 +1023,46 @@ void NoiseReductionWorker::GatherStatistics(Statistics& statistics)
 #endif
 }
 
-// Return true iff the given band of the "center" window looks like noise.
-// Examine the band in a few neighboring windows to decide.
-inline
-bool NoiseReductionWorker::Classify(const Statistics& statistics, unsigned nWindows, int band)
+const float* NoiseReductionWorker::NoiseMeans(const Statistics& statistics, Channel& channel)
+{
+    if (!mAdaptiveNoise)
+        return &statistics.mMeans[0];
+
+    // The newest window moves the floor; the gains are for a window a few
+    // steps older, so the floor looks a little ahead of it
+    NoiseFloorTracker& tracker = *channel.mTracker;
+    tracker.Update(channel.mHistory.Spectrum(0));
+
+    const float* pTracked = &tracker.Means()[0];
+    const float* pProfile = &statistics.mMeans[0];
+    float* pMean = &channel.mNoiseMeans[0];
+    if (statistics.mTotalWindows == 0)
+        // No profile: the floor alone
+        std::copy(pTracked, pTracked + mSpectrumSize, pMean);
+    else if (!tracker.Started())
+        std::copy(pProfile, pProfile + mSpectrumSize, pMean);
+    else {
+        const float weight = mAdaptiveWeight;
+        for (size_t jj = 0; jj < mSpectrumSize; ++jj)
+            pMean[jj] = pProfile[jj] + weight * (pTracked[jj] - pProfile[jj]);
+    }
+    return pMean;
+}
+
+// Set gains in [mBinLow, mBinHigh) to 1 where the band of the "center"
+// window looks like noise and 0 elsewhere.  Examine the band in a few
+// neighboring windows to decide.  The bins go through in blocks, one row
+// of the history at a time, keeping the greatest few powers of each bin
+// with a rank update that has no branches, so the loops vectorize.
+template<typename Shape>
+void NoiseReductionWorker::Classify(const float* means, Channel& channel, unsigned nWindows, float* gains)
 {
-    switch (mMethod) {
+    const History& history = channel.mHistory;
+    const int binLow = Shape::Fixed ? 0 : mBinLow;
+    const int binHigh = Shape::Fixed ? (int)(Shape::WindowSize / 2 + 1) : mBinHigh;
+    if (Shape::Fixed)
+        nWindows = 1 + Shape::StepsPerWindow;
+
     // New methods suppose an exponential distribution of power values
     // in the noise; NEW sensitivity (which is nonnegative) is meant to be
     // the negative of a log of probability (so the log is nonpositive)
@@ -604,6 +1070,8 @@ bool NoiseReductionWorker::Classify(const Statistics& statistics, unsigned nWind
     // 1 - F.  The quantile function of an exponential distribution is
     // - log (1 - F) * mean.  Thus simply multiply mean by sensitivity
     // to get the threshold.
+    bool median;
+    switch (Shape::Fixed ? Shape::Method : mMethod) {
     case DM_MEDIAN:
         // This method examines the window and all other windows
         // whose centers lie on or between its boundaries, and takes a median, to
@@ -613,81 +1081,103 @@ bool NoiseReductionWorker::Classify(const Statistics& statistics, unsigned nWind
         // (distorting the signal with a drop out).
         if (nWindows <= 3)
             // No different from second greatest.
-            goto secondGreatest;
+            median = false;
         else if (nWindows <= 5)
-        {
-            float greatest = 0.0, second = 0.0, third = 0.0;
-            for (unsigned ii = 0; ii < nWindows; ++ii) {
-                const float power = mQueue[ii]->mSpectrums[band];
-                if (power >= greatest)
-                    third = second, second = greatest, greatest = power;
-                else if (power >= second)
-                    third = second, second = power;
-                else if (power >= third)
-                    third = power;
-            }
-            return third <= mNewSensitivity * statistics.mMeans[band];
-        }
+            median = true;
         else {
-            // not implemented
-            assert(false);
-            return true;
+            // More windows than the ranks below keep: the channel holds
+            // them sorted, and the newest slides in and the oldest out
+            SlidingMedian& sliding = *channel.mMedian;
+            sliding.Insert(history.Spectrum(0));
+            const double sensitivity = mNewSensitivity;
+            const float* pMedian = sliding.Median();
+            for (int jj = binLow; jj < binHigh; ++jj)
+                gains[jj] = pMedian[jj] <= sensitivity * means[jj] ? 1.0f : 0.0f;
+            sliding.Remove(history.Spectrum(nWindows - 1));
+            return;
         }
-    secondGreatest:
+        break;
     case DM_SECOND_GREATEST:
-    {
         // This method just throws out the high outlier.  It
         // should be less prone to distortions and more prone to
         // chimes.
-        float greatest = 0.0, second = 0.0;
-        for (unsigned ii = 0; ii < nWindows; ++ii) {
-            const float power = mQueue[ii]->mSpectrums[band];
-            if (power >= greatest)
-                second = greatest, greatest = power;
-            else if (power >= second)
-                second = power;
-        }
-        return second <= mNewSensitivity * statistics.mMeans[band];
-    }
+        median = false;
+        break;
     default:
         assert(false);
-        return true;
+        std::fill(gains + binLow, gains + binHigh, 1.0f);
+        return;
+    }
+
+    const double sensitivity = mNewSensitivity;
+    const int BLOCK = 256;
+    float greatest[BLOCK], second[BLOCK], ranked[BLOCK];
+    for (int start = binLow; start < binHigh; start += BLOCK) {
+        const int count = std::min(BLOCK, binHigh - start);
+        std::fill(greatest, greatest + count, 0.0f);
+        std::fill(second, second + count, 0.0f);
+        std::fill(ranked, ranked + count, 0.0f);
+
+        // Each power moves the ones below it down a rank
+        for (unsigned ii = 0; ii < nWindows; ++ii) {
+            const float* pPower = history.Spectrum(ii) + start;
+            for (int kk = 0; kk < count; ++kk) {
+                const float power = pPower[kk];
+                const float g = greatest[kk], s = second[kk];
+                ranked[kk] = std::max(ranked[kk], std::min(power, s));
+                second[kk] = std::max(s, std::min(power, g));
+                greatest[kk] = std::max(g, power);
+            }
+        }
+
+        const float* pRanked = median ? ranked : second;
+        const float* pMean = means + start;
+        float* pGain = gains + start;
+        for (int kk = 0; kk < count; ++kk)
+            pGain[kk] = pRanked[kk] <= sensitivity * pMean[kk] ? 1.0f : 0.0f;
     }
 }
 
-void NoiseReductionWorker::ReduceNoise
-(const Statistics& statistics, OutputTrack* outputTrack)
+template<typename Shape>
+void NoiseReductionWorker::ComputeGains
+(const Statistics& statistics, Channel& channel)
 {
-    auto nWindows = std::min(mNWindowsToExamine, (unsigned)mHistoryLen);
+    const size_t spectrumSize = Shape::Fixed ? Shape::WindowSize / 2 + 1 : mSpectrumSize;
+    const int binLow = Shape::Fixed ? 0 : mBinLow;
+    const int binHigh = Shape::Fixed ? (int)spectrumSize : mBinHigh;
+    const unsigned nWindows = Shape::Fixed
+        ? 1 + Shape::StepsPerWindow
+        : std::min(mNWindowsToExamine, (unsigned)mHistoryLen);
+    const unsigned center = Shape::Fixed ? nWindows / 2 : mCenter;
+
+    const History& history = channel.mHistory;
+    const float* const means = NoiseMeans(statistics, channel);
 
     // Raise the gain for elements in the center of the sliding history
     // or, if isolating noise, zero out the non-noise
-    if (nWindows > mCenter) {
-        float* pGain = &mQueue[mCenter]->mGains[0];
+    if (nWindows > center) {
+        float* pGain = history.Gains(center);
         if (mNoiseReductionChoice == NRC_ISOLATE_NOISE) {
             // Keep Classify-based logic for isolate mode
-            std::fill(pGain, pGain + mBinLow, 0.0f);
-            std::fill(pGain + mBinHigh, pGain + mSpectrumSize, 0.0f);
-            pGain += mBinLow;
-            for (int jj = mBinLow; jj < mBinHigh; ++jj) {
-                const bool isNoise = Classify(statistics, nWindows, jj);
-                *pGain++ = isNoise ? 1.0f : 0.0f;
-            }
+            std::fill(pGain, pGain + binLow, 0.0f);
+            std::fill(pGain + binHigh, pGain + spectrumSize, 0.0f);
+            Classify<Shape>(means, channel, nWindows, pGain);
         } else {
-            // Wiener soft mask for NRC_REDUCE_NOISE and NRC_LEAVE_RESIDUE
-            std::fill(pGain, pGain + mBinLow, 1.0f);
-            std::fill(pGain + mBinHigh, pGain + mSpectrumSize, 1.0f);
-            pGain += mBinLow;
-            const float* pMean = &statistics.mMeans[mBinLow];
-            for (int jj = mBinLow; jj < mBinHigh; ++jj, ++pGain, ++pMean) {
-                const float spectrum = mQueue[mCenter]->mSpectrums[jj];
-                const float mean = *pMean;
-                if (mean > 0.0f) {
-                    const float snr = std::max(spectrum / mean - 1.0f, 0.0f);
-                    *pGain = std::max(snr / (1.0f + snr), mNoiseAttenFactor);
-                } else {
-                    *pGain = mNoiseAttenFactor;
-                }
+            // Wiener soft mask for NRC_REDUCE_NOISE and NRC_LEAVE_RESIDUE.
+            // A zero mean makes a NaN that the last select drops, so the
+            // loop has no branch.
+            std::fill(pGain, pGain + binLow, 1.0f);
+            std::fill(pGain + binHigh, pGain + spectrumSize, 1.0f);
+            const float atten = mNoiseAttenFactor;
+            const float* pMean = means;
+            const float* pSpectrum = history.Spectrum(center);
+            for (int jj = binLow; jj < binHigh; ++jj) {
+                const float mean = pMean[jj];
+                const float excess = pSpectrum[jj] / mean - 1.0f;
+                const float snr = excess < 0.0f ? 0.0f : excess;
+                const float wiener = snr / (1.0f + snr);
+                const float gain = wiener < atten ? atten : wiener;
+                pGain[jj] = mean > 0.0f ? gain : atten;
             }
         }
     }
@@ -699,20 +1189,20 @@ void NoiseReductionWorker::ReduceNoise
         // the decay curve, and their prior values.
 
         // First, the attack, which goes backward in time, which is,
-        // toward higher indices in the queue.
-
-        for (size_t jj = 0; jj < mSpectrumSize; ++jj) {
-            for (unsigned ii = mCenter + 1; ii < mHistoryLen; ++ii) {
-                const float minimum =
-                    std::max(mNoiseAttenFactor,
-                        mQueue[ii - 1]->mGains[jj] * mOneBlockAttack);
-                float& gain = mQueue[ii]->mGains[jj];
-                if (gain < minimum)
-                    gain = minimum;
-                else
-                    // We can stop now, our attack curve is intersecting
-                    // the decay curve of some window previously processed.
-                    break;
+        // toward higher indices in the queue.  A row older than the center
+        // already holds at least the decay of the row before it, from the
+        // windows processed earlier, so once a bin's curve meets its prior
+        // values it stays under them; taking the maximum through every row
+        // gives the same gains as stopping there, a row at a time.
+        const float attack = mOneBlockAttack;
+        const float atten = mNoiseAttenFactor;
+        for (unsigned ii = center + 1; ii < mHistoryLen; ++ii) {
+            const float* pPrevGain = history.Gains(ii - 1);
+            float* pGain = history.Gains(ii);
+            for (size_t jj = 0; jj < spectrumSize; ++jj) {
+                const float decayed = pPrevGain[jj] * attack;
+                const float minimum = decayed > atten ? decayed : atten;
+                pGain[jj] = pGain[jj] < minimum ? minimum : pGain[jj];
             }
         }
 
@@ -720,93 +1210,193 @@ void NoiseReductionWorker::ReduceNoise
         // be visited again when we examine the next window, and
         // carry the decay further.
         {
-            float* pNextGain = &mQueue[mCenter - 1]->mGains[0];
-            const float* pThisGain = &mQueue[mCenter]->mGains[0];
-            for (int nn = mSpectrumSize; nn--;) {
-                *pNextGain =
-                    std::max(*pNextGain,
-                        std::max(mNoiseAttenFactor,
-                            *pThisGain++ * mOneBlockRelease));
-                ++pNextGain;
+            const float release = mOneBlockRelease;
+            float* pNextGain = history.Gains(center - 1);
+            const float* pThisGain = history.Gains(center);
+            for (size_t jj = 0; jj < spectrumSize; ++jj) {
+                const float decayed = pThisGain[jj] * release;
+                const float minimum = atten < decayed ? decayed : atten;
+                pNextGain[jj] = pNextGain[jj] < minimum ? minimum : pNextGain[jj];
             }
         }
     }
+}
+
+void NoiseReductionWorker::LinkGains()
+{
+    // Give every channel the greatest of the channels' gains in each band
+    // of the outgoing window.  Equal gains keep the level ratio between
+    // channels, which is what the direction finding relies on.
+    const size_t nChannels = mChannels.size();
+    float* pFirst = mChannels[0].mHistory.Gains(mHistoryLen - 1);
+    for (size_t cc = 1; cc < nChannels; ++cc) {
+        const float* pGain = mChannels[cc].mHistory.Gains(mHistoryLen - 1);
+        for (size_t jj = 0; jj < mSpectrumSize; ++jj)
+            pFirst[jj] = std::max(pFirst[jj], pGain[jj]);
+    }
+    for (size_t cc = 1; cc < nChannels; ++cc) {
+        float* pGain = mChannels[cc].mHistory.Gains(mHistoryLen - 1);
+        std::copy(pFirst, pFirst + mSpectrumSize, pGain);
+    }
+}
 
+template<typename Shape>
+void NoiseReductionWorker::SynthesizeStep(Channel& channel, OutputTrack* outputTrack)
+{
+    const size_t windowSize = Shape::Fixed ? Shape::WindowSize : mWindowSize;
+    const size_t spectrumSize = windowSize / 2 + 1;
+    const size_t stepSize = Shape::Fixed ? windowSize / Shape::StepsPerWindow : mStepSize;
 
-    if (mOutStepCount >= -(int)(mStepsPerWindow - 1)) {
-        Record& record = *mQueue[mHistoryLen - 1];  // end of the queue
-        const auto last = mSpectrumSize - 1;
+    FloatVector& fftBuffer = channel.mFFTBuffer;
+    FloatVector& outOverlapBuffer = channel.mOutOverlapBuffer;
 
-        if (mNoiseReductionChoice != NRC_ISOLATE_NOISE)
-            // Apply frequency smoothing to output gain
-            // Gains are not less than mNoiseAttenFactor
-            ApplyFreqSmoothing(record.mGains);
+    const History& history = channel.mHistory;
+    const unsigned last = mHistoryLen - 1;  // end of the queue
 
-        // Apply gain to FFT
-        {
-            const float* pGain = &record.mGains[1];
-            const float* pReal = &record.mRealFFTs[1];
-            const float* pImag = &record.mImagFFTs[1];
-            float* pBuffer = &mFFTBuffer[2];
-            auto nn = mSpectrumSize - 2;
-            if (mNoiseReductionChoice == NRC_LEAVE_RESIDUE) {
-                for (; nn--;) {
-                    // Subtract the gain we would otherwise apply from 1, and
-                    // negate that to flip the phase.
-                    const double gain = *pGain++ - 1.0;
-                    *pBuffer++ = *pReal++ * gain;
-                    *pBuffer++ = *pImag++ * gain;
-                }
-                mFFTBuffer[0] = record.mRealFFTs[0] * (record.mGains[0] - 1.0);
-                // The Fs/2 component is stored as the imaginary part of the DC component
-                mFFTBuffer[1] = record.mImagFFTs[0] * (record.mGains[last] - 1.0);
+    if (mNoiseReductionChoice != NRC_ISOLATE_NOISE)
+        // Apply frequency smoothing to output gain
+        // Gains are not less than mNoiseAttenFactor
+        ApplyFreqSmoothing(channel, history.Gains(last));
+
+    // Apply gain to FFT
+    {
+        const float* pGain = history.Gains(last);
+        const float* pReal = history.Real(last);
+        const float* pImag = history.Imag(last);
+        float* pOutReal = &channel.mSynthReal[0];
+        float* pOutImag = &channel.mSynthImag[0];
+        if (mNoiseReductionChoice == NRC_LEAVE_RESIDUE) {
+            for (size_t ii = 0; ii < spectrumSize; ++ii) {
+                // Subtract the gain we would otherwise apply from 1, and
+                // negate that to flip the phase.
+                const double gain = pGain[ii] - 1.0;
+                pOutReal[ii] = pReal[ii] * gain;
+                pOutImag[ii] = pImag[ii] * gain;
             }
-            else {
-                for (; nn--;) {
-                    const double gain = *pGain++;
-                    *pBuffer++ = *pReal++ * gain;
-                    *pBuffer++ = *pImag++ * gain;
-                }
-                mFFTBuffer[0] = record.mRealFFTs[0] * record.mGains[0];
-                // The Fs/2 component is stored as the imaginary part of the DC component
-                mFFTBuffer[1] = record.mImagFFTs[0] * record.mGains[last];
+        }
+        else {
+            for (size_t ii = 0; ii < spectrumSize; ++ii) {
+                pOutReal[ii] = pReal[ii] * pGain[ii];
+                pOutImag[ii] = pImag[ii] * pGain[ii];
             }
         }
+    }
 
-        // Invert the FFT into the output buffer
-        InverseRealFFTf(&mFFTBuffer[0], hFFT.get());
+    // Invert the FFT into the output buffer, in natural order
+    InverseRealFFTfOrdered(hFFT.get(), &channel.mSynthReal[0], &channel.mSynthImag[0], &fftBuffer[0]);
 
-        // Overlap-add
-        if (mOutWindow.size() > 0) {
-            float* pOut = &mOutOverlapBuffer[0];
-            float* pWindow = &mOutWindow[0];
-            int* pBitReversed = &hFFT->BitReversed[0];
-            for (unsigned int jj = 0; jj < last; ++jj) {
-                int kk = *pBitReversed++;
-                *pOut++ += mFFTBuffer[kk] * (*pWindow++);
-                *pOut++ += mFFTBuffer[kk + 1] * (*pWindow++);
-            }
+    // Overlap-add
+    {
+        float* pOut = &outOverlapBuffer[0];
+        const float* pBuffer = &fftBuffer[0];
+        if (Shape::Fixed || mOutWindow.size() > 0) {
+            const float* pWindow = &mOutWindow[0];
+            for (size_t ii = 0; ii < windowSize; ++ii)
+                pOut[ii] += pBuffer[ii] * pWindow[ii];
         }
         else {
-            float* pOut = &mOutOverlapBuffer[0];
-            int* pBitReversed = &hFFT->BitReversed[0];
-            for (unsigned int jj = 0; jj < last; ++jj) {
-                int kk = *pBitReversed++;
-                *pOut++ += mFFTBuffer[kk];
-                *pOut++ += mFFTBuffer[kk + 1];
-            }
+            for (size_t ii = 0; ii < windowSize; ++ii)
+                pOut[ii] += pBuffer[ii];
         }
+    }
 
-        float* buffer = &mOutOverlapBuffer[0];
-        if (mOutStepCount >= 0) {
-            // Output the first portion of the overlap buffer, they're done
-            outputTrack->Append(buffer, mStepSize);
-        }
+    float* buffer = &outOverlapBuffer[0];
+    if (mOutStepCount >= 0) {
+        // Output the first portion of the overlap buffer, they're done
+        EmitStep(channel, buffer, outputTrack);
+    }
 
-        // Shift the remainder over.
-        memmove(buffer, buffer + mStepSize, sizeof(float) * (mWindowSize - mStepSize));
-        std::fill(buffer + mWindowSize - mStepSize, buffer + mWindowSize, 0.0f);
+    // Shift the remainder over.
+    memmove(buffer, buffer + stepSize, sizeof(float) * (windowSize - stepSize));
+    std::fill(buffer + windowSize - stepSize, buffer + windowSize, 0.0f);
+}
+
+void NoiseReductionWorker::EmitStep(Channel& channel, const float* buffer, OutputTrack* outputTrack)
+{
+    if (outputTrack) {
+        // Offline processing of a single track
+        assert(mChannels.size() == 1);
+        outputTrack->Append(buffer, mStepSize);
+        return;
     }
+
+    // Streaming: queue the step until ProcessStream hands it out
+    assert(channel.mStreamOutputLen + mStepSize <= channel.mStreamOutput.size());
+    memmove(&channel.mStreamOutput[channel.mStreamOutputLen], buffer, mStepSize * sizeof(float));
+    channel.mStreamOutputLen += mStepSize;
+}
+
+size_t NoiseReductionWorker::StreamLatency(size_t blockSize) const
+{
+    // The first step of output is finished once the history queue is full
+    // and the zero-padded windows have passed, that is after
+    // (mHistoryLen + mStepsPerWindow - 1) steps of input.  Blocks that are
+    // not a multiple of the step size may end part way into a step, which
+    // costs up to one more step of delay.
+    const size_t steps = mHistoryLen + mStepsPerWindow - 2;
+    return steps * mStepSize + mStepSize - std::gcd(blockSize, mStepSize);
+}
+
+void NoiseReductionWorker::StartStream(size_t blockSize)
+{
+    StartNewTrack();
+
+    // Started here, so the threads exist before the first block
+    if (mParallelChannels && mChannels.size() > 1 && !mTeam)
+        mTeam = std::make_unique<ChannelTeam>(mChannels.size());
+
+    // Output begins with the latency's worth of silence; after that every
+    // block of input finishes at least a block of output.
+    const size_t latency = StreamLatency(blockSize);
+    for (auto& channel : mChannels) {
+        channel.mStreamOutput.assign(latency + blockSize + mStepSize, 0.0f);
+        channel.mStreamOutputLen = latency;
+    }
+}
+
+void NoiseReductionWorker::ProcessStream(Statistics& statistics,
+    const float* const* inputs, size_t inStride,
+    float* const* outputs, size_t outStride, size_t len)
+{
+    mInSampleCount += len;
+    ProcessSamples(statistics, inputs, inStride, len, nullptr);
+
+    for (size_t cc = 0, nn = mChannels.size(); cc < nn; ++cc) {
+        Channel& channel = mChannels[cc];
+        const size_t avail = std::min(len, channel.mStreamOutputLen);
+
+        float* pOut = outputs[cc];
+        const float* pStep = &channel.mStreamOutput[0];
+        for (size_t ii = 0; ii < avail; ++ii, pOut += outStride)
+            *pOut = *pStep++;
+        for (size_t ii = avail; ii < len; ++ii, pOut += outStride)
+            *pOut = 0.0f;
+
+        channel.mStreamOutputLen -= avail;
+        memmove(&channel.mStreamOutput[0], &channel.mStreamOutput[avail],
+            channel.mStreamOutputLen * sizeof(float));
+    }
+}
+
+void NoiseReductionWorker::StartProfileTrack()
+{
+    assert(mDoProfile);
+    StartNewTrack();
+}
+
+void NoiseReductionWorker::ProfileSamples(Statistics& statistics, const float* buffer, size_t len)
+{
+    mInSampleCount += len;
+    const size_t nChannels = mChannels.size();
+    std::vector<const float*> buffers(nChannels);
+    for (size_t cc = 0; cc < nChannels; ++cc)
+        buffers[cc] = buffer + cc;
+    ProcessSamples(statistics, buffers.data(), nChannels, len, nullptr);
+}
+
+void NoiseReductionWorker::FinishProfileTrack(Statistics& statistics)
+{
+    FinishTrackStatistics(statistics);
 }
 
 bool NoiseReductionWorker::ProcessOne(Statistics& statistics, InputTrack& inputTrack, OutputTrack* outputTrack)
@@ -831,7 +1421,8 @@ bool NoiseReductionWorker::ProcessOne(Statistics& statistics, InputTrack& inputT
 
         i += len;
         mInSampleCount += len;
-        ProcessSamples(statistics, &buffer[0], len, outputTrack);
+        const float* buffers[] = { &buffer[0] };
+        ProcessSamples(statistics, buffers, 1, len, outputTrack);
     }
 
     if (bLoopSuccess) {
@@ -860,25 +1451,202 @@ NoiseReduction::NoiseReduction(NoiseReduction::Settings& settings, double sample
 // found out why destructor is important:
 // otherwise error with unique_ptr because Statistics is incomplete type
 // also important to define destructor here, not directly in header, because Statistics needs to be defined
-NoiseReduction::~NoiseReduction() = default;
+NoiseReduction::~NoiseReduction() {
+    delete mPublishedStatistics.load();
+    delete mRetiredStatistics.load();
+}
 
 void NoiseReduction::ProfileNoise(InputTrack& profileTrack) {
 
-    NoiseReduction::Settings profileSettings(mSettings);
-    profileSettings.mDoProfile = true;
-    NoiseReductionWorker profileWorker(profileSettings, mSampleRate);
+    BeginProfile();
+    ProfileSamples(profileTrack.Buffer().data(), profileTrack.Length());
+    EndProfile();
+}
 
-    if (!profileWorker.ProcessOne(*this->mStatistics, profileTrack, nullptr)) {
-        throw std::runtime_error("Cannot process track");
+void NoiseReduction::BeginProfile(size_t channels) {
+
+    mProfiler = std::make_unique<NoiseProfiler>(mSettings, mSampleRate, channels);
+}
+
+void NoiseReduction::ProfileSamples(const float* samples, size_t frames) {
+
+    if (!mProfiler) {
+        throw std::logic_error("ProfileSamples called outside of a profile");
+    }
+
+    mProfiler->ProfileSamples(samples, frames);
+}
+
+void NoiseReduction::EndProfileTrack() {
+
+    if (!mProfiler) {
+        throw std::logic_error("EndProfileTrack called outside of a profile");
     }
 
-    if (this->mStatistics->mTotalWindows == 0) {
+    mProfiler->EndTrack();
+}
+
+void NoiseReduction::EndProfile() {
+
+    if (!mProfiler) {
+        throw std::logic_error("EndProfile called outside of a profile");
+    }
+
+    const NoiseProfile gathered = mProfiler->Finish();
+    mProfiler.reset();
+
+    // Adds to whatever was profiled before, as ProfileNoise always has
+    NoiseProfile profile = GetNoiseProfile();
+    profile.Merge(gathered);
+    SetNoiseProfile(profile);
+}
+
+static NoiseProfile MakeNoiseProfile(const Statistics& statistics) {
+
+    NoiseProfile profile;
+    profile.mRate = statistics.mRate;
+    profile.mWindowSize = statistics.mWindowSize;
+    profile.mWindowTypes = statistics.mWindowTypes;
+    profile.mTotalWindows = statistics.mTotalWindows;
+    profile.mMeans = statistics.mMeans;
+    return profile;
+}
+
+NoiseProfile NoiseReduction::GetNoiseProfile() const {
+
+    return MakeNoiseProfile(*mStatistics);
+}
+
+void NoiseReduction::CheckNoiseProfile(const NoiseProfile& profile) const {
+
+    // Only what is fixed at construction is read, so any thread may check
+    if (profile.mRate != mSampleRate ||
+        profile.mWindowSize != mSettings.WindowSize() ||
+        profile.mWindowTypes != mSettings.mWindowTypes ||
+        profile.mMeans.size() != 1 + mSettings.WindowSize() / 2) {
+        throw std::invalid_argument("Noise profile does not match the settings.");
+    }
+
+    if (profile.mTotalWindows == 0) {
         throw std::invalid_argument("Selected noise profile is too short.");
     }
 }
 
+void NoiseReduction::SetNoiseProfile(const NoiseProfile& profile) {
+
+    CheckNoiseProfile(profile);
+
+    mStatistics->mTotalWindows = profile.mTotalWindows;
+    mStatistics->mTrackWindows = 0;
+    mStatistics->mMeans = profile.mMeans;
+    std::fill(mStatistics->mSums.begin(), mStatistics->mSums.end(), 0.0f);
+}
+
+void NoiseReduction::PublishNoiseProfile(const NoiseProfile& profile) {
+
+    CheckNoiseProfile(profile);
+
+    auto statistics = std::make_unique<Statistics>(profile.mMeans.size(), profile.mRate, profile.mWindowTypes);
+    statistics->mTotalWindows = profile.mTotalWindows;
+    statistics->mMeans = profile.mMeans;
+
+    std::lock_guard<std::mutex> lock(mPublishMutex);
+
+    // A profile the stream has not taken up yet is simply replaced; the
+    // stream never saw it, since taking it empties the slot
+    delete mPublishedStatistics.exchange(statistics.release(), std::memory_order_acq_rel);
+
+    // Only after the new one is out: the stream may be parking the current
+    // statistics at this moment, and they are free to go once parked
+    delete mRetiredStatistics.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+void NoiseReduction::AdoptPublishedProfile() {
+
+    if (mPublishedStatistics.load(std::memory_order_relaxed) == nullptr)
+        return;
+
+    // Only this thread fills the retired slot.  While it is still full the
+    // swap waits for a later block; PublishNoiseProfile empties it.
+    if (mRetiredStatistics.load(std::memory_order_acquire) != nullptr)
+        return;
+
+    Statistics* published = mPublishedStatistics.exchange(nullptr, std::memory_order_acq_rel);
+    if (published == nullptr)
+        return;
+
+    mRetiredStatistics.store(mStatistics.release(), std::memory_order_release);
+    mStatistics.reset(published);
+}
+
+bool NoiseProfile::Compatible(const NoiseProfile& other) const {
+    return mRate == other.mRate
+        && mWindowSize == other.mWindowSize
+        && mWindowTypes == other.mWindowTypes
+        && mMeans.size() == other.mMeans.size();
+}
+
+void NoiseProfile::Merge(const NoiseProfile& other) {
+
+    if (other.mTotalWindows == 0)
+        return;
+
+    if (mTotalWindows == 0) {
+        *this = other;
+        return;
+    }
+
+    if (!Compatible(other)) {
+        throw std::invalid_argument("Cannot merge noise profiles of different settings.");
+    }
+
+    // As FinishTrackStatistics combines the tracks of one profile
+    const double weight = mTotalWindows;
+    const double otherWeight = other.mTotalWindows;
+    const double denom = weight + otherWeight;
+    for (size_t ii = 0, nn = mMeans.size(); ii < nn; ++ii)
+        mMeans[ii] = (float)((mMeans[ii] * weight + other.mMeans[ii] * otherWeight) / denom);
+    mTotalWindows += other.mTotalWindows;
+}
+
+NoiseProfiler::NoiseProfiler(const NoiseReduction::Settings& settings, double sampleRate, size_t channels) {
+
+    NoiseReduction::Settings profileSettings(settings);
+    profileSettings.mDoProfile = true;
+
+    const size_t spectrumSize = 1 + settings.WindowSize() / 2;
+    mStatistics = std::make_unique<Statistics>(spectrumSize, sampleRate, settings.mWindowTypes);
+    mWorker = std::make_unique<NoiseReductionWorker>(profileSettings, sampleRate, channels);
+    mWorker->StartProfileTrack();
+}
+
+NoiseProfiler::~NoiseProfiler() = default;
+
+void NoiseProfiler::ProfileSamples(const float* samples, size_t frames) {
+
+    mWorker->ProfileSamples(*mStatistics, samples, frames);
+    mTrackFrames += frames;
+}
+
+void NoiseProfiler::EndTrack() {
+
+    if (mTrackFrames > 0) {
+        mWorker->FinishProfileTrack(*mStatistics);
+        mWorker->StartProfileTrack();
+        mTrackFrames = 0;
+    }
+}
+
+NoiseProfile NoiseProfiler::Finish() {
+
+    EndTrack();
+    return MakeNoiseProfile(*mStatistics);
+}
+
 void NoiseReduction::ReduceNoise(InputTrack& inputTrack, OutputTrack& outputTrack) {
 
+    AdoptPublishedProfile();
+
     NoiseReduction::Settings cleanSettings(mSettings);
     cleanSettings.mDoProfile = false;
     NoiseReductionWorker cleanWorker(cleanSettings, mSampleRate);
@@ -888,6 +1656,60 @@ void NoiseReduction::ReduceNoise(InputTrack& inputTrack, OutputTrack& outputTrac
     }
 }
 
+void NoiseReduction::BeginStream(size_t channels, size_t blockSize) {
+
+    AdoptPublishedProfile();
+
+    NoiseReduction::Settings cleanSettings(mSettings);
+    cleanSettings.mDoProfile = false;
+
+    mStreamBlockSize = blockSize;
+    mStreamWorker = std::make_unique<NoiseReductionWorker>(cleanSettings, mSampleRate, channels);
+    mStreamWorker->StartStream(blockSize);
+
+    mStreamInputs.resize(channels);
+    mStreamOutputs.resize(channels);
+}
+
+void NoiseReduction::ProcessBlock(const float* const* buffers, float* const* outputs, size_t len) {
+
+    if (!mStreamWorker) {
+        throw std::logic_error("ProcessBlock called outside of a stream");
+    }
+
+    AdoptPublishedProfile();
+
+    mStreamWorker->ProcessStream(*this->mStatistics, buffers, 1, outputs, 1, len);
+}
+
+void NoiseReduction::ProcessInterleaved(const float* buffer, float* output, size_t frames) {
+
+    if (!mStreamWorker) {
+        throw std::logic_error("ProcessInterleaved called outside of a stream");
+    }
+
+    AdoptPublishedProfile();
+
+    const size_t channels = mStreamInputs.size();
+    for (size_t cc = 0; cc < channels; ++cc) {
+        mStreamInputs[cc] = buffer + cc;
+        mStreamOutputs[cc] = output + cc;
+    }
+
+    mStreamWorker->ProcessStream(*this->mStatistics,
+        mStreamInputs.data(), channels, mStreamOutputs.data(), channels, frames);
+}
+
+void NoiseReduction::EndStream() {
+    mStreamWorker.reset();
+}
+
+size_t NoiseReduction::StreamLatency() const {
+    if (!mStreamWorker)
+        return 0;
+    return mStreamWorker->StreamLatency(mStreamBlockSize);
+}
+
 NoiseReduction::Settings::Settings() {
     mDoProfile = false;
 
@@ -903,4 +1725,29 @@ NoiseReduction::Settings::Settings() {
     mAttackTime = 0.02;
     mReleaseTime = 0.10;
     mFreqSmoothingBands = 0;
+
+    mLinkChannels = false;
+    mParallelChannels = false;
+
+    mAdaptiveNoise = false;
+    mAdaptiveWeight = DEFAULT_ADAPTIVE_WEIGHT;
+}
+
+bool NoiseReduction::Settings::operator==(const Settings& other) const {
+    return mDoProfile == other.mDoProfile &&
+        mNewSensitivity == other.mNewSensitivity &&
+        mFreqSmoothingBands == other.mFreqSmoothingBands &&
+        mNoiseGain == other.mNoiseGain &&
+        mAttackTime == other.mAttackTime &&
+        mReleaseTime == other.mReleaseTime &&
+        mOldSensitivity == other.mOldSensitivity &&
+        mNoiseReductionChoice == other.mNoiseReductionChoice &&
+        mWindowTypes == other.mWindowTypes &&
+        mWindowSizeChoice == other.mWindowSizeChoice &&
+        mStepsPerWindowChoice == other.mStepsPerWindowChoice &&
+        mMethod == other.mMethod &&
+        mLinkChannels == other.mLinkChannels &&
+        mParallelChannels == other.mParallelChannels &&
+        mAdaptiveNoise == other.mAdaptiveNoise &&
+        mAdaptiveWeight == other.mAdaptiveWeight;
 }
\ No newline at end of file
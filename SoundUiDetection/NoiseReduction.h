@@ -7,7 +7,10 @@
 **********************************************************************/
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include "InputTrack.h"
 #include "OutputTrack.h"
 
@@ -18,6 +21,26 @@ typedef char* samplePtr;
 
 class NoiseReductionWorker;
 class Statistics;
+
+// A finished noise profile in plain form, for storing and combining: the
+// mean power of the noise in every bin and how many windows that mean is
+// taken over.  Profiles of the same rate, window size and window types
+// merge into the profile of all their noise together.
+struct NoiseProfile {
+    double     mRate = 0;
+    size_t     mWindowSize = 0;
+    int        mWindowTypes = 0;
+    unsigned   mTotalWindows = 0;
+    FloatVector mMeans;
+
+    bool Compatible(const NoiseProfile& other) const;
+    // Window-weighted mean of the two; the result does not depend on
+    // anything but the order of the merges
+    void Merge(const NoiseProfile& other);
+};
+
+class NoiseProfiler;
+
 class NoiseReduction {
 public:
     struct Settings {
@@ -25,6 +48,8 @@ public:
 
         size_t WindowSize() const { return 1u << (3 + mWindowSizeChoice); }
         unsigned StepsPerWindow() const { return 1u << (1 + mStepsPerWindowChoice); }
+        bool operator==(const Settings& other) const;
+        bool operator!=(const Settings& other) const { return !(*this == other); }
         bool       mDoProfile;
         double     mNewSensitivity;   // - log10 of a probability... yeah.
         double     mFreqSmoothingBands; // really an integer
@@ -43,14 +68,98 @@ public:
         int        mWindowSizeChoice;
         int        mStepsPerWindowChoice;
         int        mMethod;
+
+        // Multi-channel streams:
+        bool       mLinkChannels;     // same gain in every channel, keeps the stereo image
+        bool       mParallelChannels; // one core per channel instead of one after the other
+
+        // Adaptive noise floor, tracked from the signal being reduced; with
+        // a profile as well, mAdaptiveWeight of the floor is mixed into it
+        bool       mAdaptiveNoise;
+        double     mAdaptiveWeight;   // 0 to 1
     };
 
     NoiseReduction(NoiseReduction::Settings& settings, double sampleRate);
     ~NoiseReduction();
     void ProfileNoise(InputTrack& profileTrack);
+
+    // Streaming profile: one worker takes the noise in chunks of any size,
+    // so memory stays at a window however long the files are.  Each file
+    // is a track of its own, ended by EndProfileTrack; no window straddles
+    // two files and the windows of all of them add up in the profile.
+    // EndProfile throws if no file was long enough for a window.  Every
+    // channel is windowed on its own, as the stream reduces it, and the
+    // windows of all channels add up in the one profile.
+    void BeginProfile(size_t channels = 1);
+    // Frames of the current track, one sample per channel, interleaved
+    void ProfileSamples(const float* samples, size_t frames);
+    void EndProfileTrack();
+    void EndProfile();
+
+    // The profile gathered so far, and replacing it with a stored one.
+    // SetNoiseProfile throws if the profile does not fit the settings.
+    // Neither may run while another thread streams; see below.
+    NoiseProfile GetNoiseProfile() const;
+    void SetNoiseProfile(const NoiseProfile& profile);
+
+    // Hands a profile over from any thread, also while another one
+    // streams: the stream takes it up at the start of its next block.  The
+    // statistics it replaces are freed by a later publish or by the
+    // destructor, never on the streaming thread.  Throws, on the calling
+    // thread, if the profile does not fit the settings.
+    void PublishNoiseProfile(const NoiseProfile& profile);
     void ReduceNoise(InputTrack& inputTrack, OutputTrack& outputTrack);
+
+    // Streaming reduction: one long-lived worker keeps the history and
+    // overlap-add state of every channel between blocks, so the priming
+    // and the final flush happen once per stream instead of once per block.
+    // Channels are processed window by window in step with each other.
+    // Output is delayed by StreamLatency() samples.
+    void BeginStream(size_t channels, size_t blockSize);
+    // Planar: one buffer of len samples per channel
+    void ProcessBlock(const float* const* buffers, float* const* outputs, size_t len);
+    // Interleaved: frames of one sample per channel
+    void ProcessInterleaved(const float* buffer, float* output, size_t frames);
+    void EndStream();
+    bool IsStreaming() const { return mStreamWorker != nullptr; }
+    const Settings& GetSettings() const { return mSettings; }
+    double SampleRate() const { return mSampleRate; }
+    size_t StreamLatency() const;
 private:
+    void CheckNoiseProfile(const NoiseProfile& profile) const;
+    // At block boundaries, on the thread that uses the statistics
+    void AdoptPublishedProfile();
+
     std::unique_ptr<Statistics> mStatistics;
+    // Published and not yet taken up, and given up and not yet freed
+    std::atomic<Statistics*> mPublishedStatistics{ nullptr };
+    std::atomic<Statistics*> mRetiredStatistics{ nullptr };
+    std::mutex mPublishMutex;
+    std::unique_ptr<NoiseReductionWorker> mStreamWorker;
+    std::unique_ptr<NoiseProfiler> mProfiler;
+    size_t mStreamBlockSize = 0;
+    std::vector<const float*> mStreamInputs;
+    std::vector<float*> mStreamOutputs;
     NoiseReduction::Settings mSettings;
     double mSampleRate;
+};
+
+// Profiles noise apart from any reducer, into statistics of its own, so
+// separate profilers may run on separate threads and their profiles be
+// merged afterwards.  Tracks and chunks work as in NoiseReduction's
+// streaming profile, channels included.
+class NoiseProfiler {
+public:
+    NoiseProfiler(const NoiseReduction::Settings& settings, double sampleRate, size_t channels = 1);
+    ~NoiseProfiler();
+    // Interleaved frames
+    void ProfileSamples(const float* samples, size_t frames);
+    void EndTrack();
+    // Ends the current track; the profile of all the tracks, with no
+    // windows if they were all too short
+    NoiseProfile Finish();
+private:
+    std::unique_ptr<Statistics> mStatistics;
+    std::unique_ptr<NoiseReductionWorker> mWorker;
+    size_t mTrackFrames = 0;
 };
\ No newline at end of file
@@ -5,7 +5,7 @@ OutputTrack::OutputTrack() :
     mLength(0)
 { }
 
-void OutputTrack::Append(float* buffer, size_t length)
+void OutputTrack::Append(const float* buffer, size_t length)
 {
     mBuffer.insert(mBuffer.end(), buffer, &buffer[length]);
     mLength += length;
@@ -6,7 +6,7 @@ class OutputTrack
 {
 public:
     OutputTrack();
-    void Append(float* buffer, size_t length);
+    void Append(const float* buffer, size_t length);
     const FloatVector& Buffer() const { return mBuffer; }
     size_t Length() const { return mLength; }
     void SetEnd(size_t newLength);
@@ -0,0 +1,168 @@
+#include "ProfileBuilder.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <omp.h>
+
+#include "WavReader.h"
+
+namespace
+{
+	// Frames read from a file per step of a segment
+	const size_t CHUNK_FRAMES = WavReader::DEFAULT_CHUNK_FRAMES;
+
+	// Frames [start, end) of one file; a file at another rate is one
+	// segment, converted as it is read
+	struct Segment
+	{
+		size_t file;
+		size_t channels;
+		sf_count_t start;
+		sf_count_t end;
+		double rate;
+	};
+
+	// Converts a chunk to the profile rate, dropping the delay of the
+	// filter from the front so the windows line up as in a file at the rate
+	class SegmentResampler
+	{
+	public:
+		SegmentResampler(double inRate, double outRate, size_t channels)
+			: mResampler(inRate, outRate, channels, ProfileBuilder::RESAMPLER_QUALITY)
+			, mSkip(mResampler.Latency())
+			, mOutput(mResampler.MaxOutput(std::max(CHUNK_FRAMES, mResampler.Taps())) * channels)
+		{
+		}
+
+		void Feed(const float* input, size_t frames, NoiseProfiler& profiler)
+		{
+			emit(mResampler.Process(input, frames, mOutput.data()), profiler);
+		}
+
+		void Finish(NoiseProfiler& profiler)
+		{
+			emit(mResampler.Flush(mOutput.data()), profiler);
+		}
+
+	private:
+		void emit(size_t frames, NoiseProfiler& profiler)
+		{
+			const size_t skip = std::min(frames, mSkip);
+			mSkip -= skip;
+			frames -= skip;
+			if (frames > 0)
+				profiler.ProfileSamples(mOutput.data() + skip * mResampler.Channels(), frames);
+		}
+
+		Resampler mResampler;
+		size_t mSkip;
+		FloatVector mOutput;
+	};
+
+	NoiseProfile profileSegment(const std::string& path, const Segment& segment,
+		const NoiseReduction::Settings& settings, double sampleRate)
+	{
+		NoiseProfiler profiler(settings, sampleRate, segment.channels);
+
+		WavReader reader(CHUNK_FRAMES);
+		if (!reader.Open(path) || !reader.Seek(segment.start))
+			return profiler.Finish();
+
+		std::unique_ptr<SegmentResampler> resampler;
+		if (segment.rate != sampleRate)
+			resampler = std::make_unique<SegmentResampler>(segment.rate, sampleRate, segment.channels);
+
+		FloatVector chunk(CHUNK_FRAMES * segment.channels);
+		sf_count_t remaining = segment.end - segment.start;
+		while (remaining > 0)
+		{
+			const sf_count_t got = (sf_count_t)reader.ReadInterleaved(chunk.data(), CHUNK_FRAMES);
+			if (got == 0)
+				break;
+
+			// The last chunk may run past the end of the segment
+			const sf_count_t frames = std::min(got, remaining);
+			if (resampler)
+				resampler->Feed(chunk.data(), (size_t)frames, profiler);
+			else
+				profiler.ProfileSamples(chunk.data(), (size_t)frames);
+			remaining -= frames;
+		}
+
+		if (resampler)
+			resampler->Finish(profiler);
+
+		return profiler.Finish();
+	}
+}
+
+std::vector<NoiseProfile> ProfileBuilder::ProfileFiles(const std::vector<std::string>& paths,
+	const NoiseReduction::Settings& settings, double sampleRate)
+{
+	const sf_count_t windowSize = (sf_count_t)settings.WindowSize();
+	const sf_count_t stepSize = windowSize / settings.StepsPerWindow();
+
+	// A segment owns the windows that start within it.  The next segment
+	// starts a whole number of steps later, and this one reads on to the
+	// end of its last window, so no window is lost or counted twice.
+	std::vector<Segment> segments;
+	for (size_t ff = 0; ff < paths.size(); ++ff)
+	{
+		WavReader reader(1);
+		if (!reader.Open(paths[ff]))
+		{
+			std::cerr << "Failed to open file: " << paths[ff] << " (" << reader.Error() << ")" << std::endl;
+			continue;
+		}
+
+		const size_t channels = reader.Channels();
+		const sf_count_t total = reader.Frames();
+		const sf_count_t length = (sf_count_t)SEGMENT_FRAMES;
+
+		// The windows of a converted file fall on the converted frames, so
+		// it cannot be cut where a file at the rate would be
+		if (reader.Rate() != sampleRate)
+		{
+			segments.push_back({ ff, channels, 0, total, (double)reader.Rate() });
+			continue;
+		}
+
+		for (sf_count_t start = 0; start == 0 || start + windowSize <= total; start += length)
+		{
+			const sf_count_t end = std::min(total, start + length + windowSize - stepSize);
+			segments.push_back({ ff, channels, start, end, sampleRate });
+		}
+	}
+
+	std::vector<NoiseProfile> partials(segments.size());
+
+#pragma omp parallel for schedule(dynamic)
+	for (int ss = 0; ss < (int)segments.size(); ++ss)
+	{
+		try
+		{
+			partials[ss] = profileSegment(paths[segments[ss].file], segments[ss], settings, sampleRate);
+		}
+		catch (const std::exception& e)
+		{
+			// Exceptions must not leave the parallel region; the segment
+			// simply adds no windows
+			std::cerr << "Failed to profile " << paths[segments[ss].file] << ": " << e.what() << std::endl;
+		}
+	}
+
+	std::vector<NoiseProfile> profiles(paths.size());
+	for (size_t ss = 0; ss < segments.size(); ++ss)
+		profiles[segments[ss].file].Merge(partials[ss]);
+
+	return profiles;
+}
+
+NoiseProfile ProfileBuilder::MergeProfiles(const std::vector<NoiseProfile>& profiles)
+{
+	NoiseProfile merged;
+	for (const auto& profile : profiles)
+		merged.Merge(profile);
+	return merged;
+}
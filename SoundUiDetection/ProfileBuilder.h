@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "NoiseReduction.h"
+#include "Resampler.h"
+
+// Noise profiles of whole sets of files, built on every core.  Files are
+// cut into segments of SEGMENT_FRAMES frames that overlap by a window, so
+// that together they hold exactly the windows of the whole file; every
+// segment is profiled by a NoiseProfiler of its own on an OpenMP thread and
+// the partial profiles are merged in file and segment order.  The segments
+// depend only on the files, so the result is the same on any number of
+// cores.  Every channel of a file is windowed on its own and adds to the
+// file's profile.  A file at another sample rate is converted to the
+// profile rate as it is read, and profiled as a single segment.
+namespace ProfileBuilder
+{
+	// Frames per segment, a multiple of every step size
+	constexpr size_t SEGMENT_FRAMES = 1 << 20;
+
+	// Profiles are built offline, so the conversion can take its time
+	constexpr ResamplerQuality RESAMPLER_QUALITY = ResamplerQuality::Best;
+
+	// One profile per file, in the order of paths; a file that cannot be
+	// read or is too short for a window gets a profile of no windows
+	std::vector<NoiseProfile> ProfileFiles(const std::vector<std::string>& paths,
+		const NoiseReduction::Settings& settings, double sampleRate);
+
+	// Window-weighted merge of profiles, in their order
+	NoiseProfile MergeProfiles(const std::vector<NoiseProfile>& profiles);
+}
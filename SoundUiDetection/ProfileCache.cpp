@@ -0,0 +1,259 @@
+#include "ProfileCache.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	const char MAGIC[8] = { 'N', 'R', 'P', 'R', 'O', 'F', 0, 0 };
+	// 2: files at another rate are converted before they are profiled
+	// 3: the channels of a file are profiled one by one, not interleaved
+	const uint32_t VERSION = 3;
+
+	// Native byte order; the file is a cache, not an exchange format
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t headerSize;
+		double sampleRate;
+		uint32_t windowSize;
+		int32_t windowTypes;
+		uint32_t stepsPerWindow;
+		uint32_t spectrumSize;
+		uint64_t totalWindows;
+		uint64_t sourceDigest;
+		uint64_t payloadChecksum;
+		// Of all the fields above
+		uint64_t headerChecksum;
+	};
+	static_assert(sizeof(Header) == 72, "Profile cache header must not have padding");
+
+	// FNV-1a, 64 bit
+	const uint64_t FNV_OFFSET = 14695981039346656037ull;
+	const uint64_t FNV_PRIME = 1099511628211ull;
+
+	uint64_t fnv1a(const void* data, size_t size, uint64_t hash = FNV_OFFSET)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t ii = 0; ii < size; ++ii)
+		{
+			hash ^= bytes[ii];
+			hash *= FNV_PRIME;
+		}
+		return hash;
+	}
+
+	uint64_t headerChecksum(const Header& header)
+	{
+		return fnv1a(&header, offsetof(Header, headerChecksum));
+	}
+
+	// Read-only view of a whole file
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const fs::path& path)
+		{
+#ifdef _WIN32
+			mFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (mFile == INVALID_HANDLE_VALUE)
+				return;
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+				return;
+
+			mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mMapping == nullptr)
+				return;
+
+			mData = MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+			if (mData != nullptr)
+				mSize = (size_t)size.QuadPart;
+#else
+			mFile = open(path.c_str(), O_RDONLY);
+			if (mFile < 0)
+				return;
+
+			struct stat info;
+			if (fstat(mFile, &info) != 0 || info.st_size == 0)
+				return;
+
+			void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, mFile, 0);
+			if (data != MAP_FAILED)
+			{
+				mData = data;
+				mSize = (size_t)info.st_size;
+			}
+#endif
+		}
+
+		~MappedFile()
+		{
+#ifdef _WIN32
+			if (mData != nullptr)
+				UnmapViewOfFile(mData);
+			if (mMapping != nullptr)
+				CloseHandle(mMapping);
+			if (mFile != INVALID_HANDLE_VALUE)
+				CloseHandle(mFile);
+#else
+			if (mData != nullptr)
+				munmap(mData, mSize);
+			if (mFile >= 0)
+				close(mFile);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const unsigned char* Data() const { return static_cast<const unsigned char*>(mData); }
+		size_t Size() const { return mSize; }
+
+	private:
+#ifdef _WIN32
+		HANDLE mFile = INVALID_HANDLE_VALUE;
+		HANDLE mMapping = nullptr;
+#else
+		int mFile = -1;
+#endif
+		void* mData = nullptr;
+		size_t mSize = 0;
+	};
+}
+
+uint64_t ProfileCache::SourceDigest(const std::vector<std::string>& paths)
+{
+	std::vector<std::string> sorted(paths);
+	std::sort(sorted.begin(), sorted.end());
+
+	uint64_t hash = FNV_OFFSET;
+	for (const auto& path : sorted)
+	{
+		std::error_code ec;
+		const uint64_t size = fs::file_size(path, ec);
+		const int64_t modified = ec ? 0 : (int64_t)fs::last_write_time(path, ec).time_since_epoch().count();
+
+		// The terminating zero keeps "ab" + "c" apart from "a" + "bc"
+		hash = fnv1a(path.c_str(), path.size() + 1, hash);
+		hash = fnv1a(&size, sizeof(size), hash);
+		hash = fnv1a(&modified, sizeof(modified), hash);
+	}
+	return hash;
+}
+
+bool ProfileCache::Load(const std::string& path, uint64_t sourceDigest,
+	const NoiseReduction::Settings& settings, double sampleRate, NoiseProfile& profile)
+{
+	MappedFile file(path);
+	if (file.Size() < sizeof(Header))
+		return false;
+
+	Header header;
+	memcpy(&header, file.Data(), sizeof(header));
+
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+		header.version != VERSION ||
+		header.headerSize != sizeof(Header) ||
+		header.headerChecksum != headerChecksum(header))
+	{
+		std::cerr << "Profile cache " << path << " is damaged or of another version" << std::endl;
+		return false;
+	}
+
+	const size_t windowSize = settings.WindowSize();
+	if (header.sourceDigest != sourceDigest ||
+		header.sampleRate != sampleRate ||
+		header.windowSize != windowSize ||
+		header.windowTypes != settings.mWindowTypes ||
+		header.stepsPerWindow != settings.StepsPerWindow() ||
+		header.spectrumSize != windowSize / 2 + 1)
+	{
+		// Stale: the noise files or the settings have changed since
+		return false;
+	}
+
+	const size_t payloadSize = header.spectrumSize * sizeof(float);
+	if (file.Size() != sizeof(Header) + payloadSize ||
+		header.totalWindows == 0 ||
+		header.payloadChecksum != fnv1a(file.Data() + sizeof(Header), payloadSize))
+	{
+		std::cerr << "Profile cache " << path << " is damaged" << std::endl;
+		return false;
+	}
+
+	profile.mRate = header.sampleRate;
+	profile.mWindowSize = header.windowSize;
+	profile.mWindowTypes = header.windowTypes;
+	profile.mTotalWindows = (unsigned)header.totalWindows;
+	profile.mMeans.resize(header.spectrumSize);
+	memcpy(profile.mMeans.data(), file.Data() + sizeof(Header), payloadSize);
+	return true;
+}
+
+bool ProfileCache::Save(const std::string& path, uint64_t sourceDigest,
+	const NoiseReduction::Settings& settings, const NoiseProfile& profile)
+{
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.headerSize = sizeof(Header);
+	header.sampleRate = profile.mRate;
+	header.windowSize = (uint32_t)profile.mWindowSize;
+	header.windowTypes = profile.mWindowTypes;
+	header.stepsPerWindow = settings.StepsPerWindow();
+	header.spectrumSize = (uint32_t)profile.mMeans.size();
+	header.totalWindows = profile.mTotalWindows;
+	header.sourceDigest = sourceDigest;
+	header.payloadChecksum = fnv1a(profile.mMeans.data(), profile.mMeans.size() * sizeof(float));
+	header.headerChecksum = headerChecksum(header);
+
+	const fs::path target(path);
+	const fs::path temporary = fs::path(path + ".tmp");
+
+	std::error_code ec;
+	if (target.has_parent_path())
+		fs::create_directories(target.parent_path(), ec);
+
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(profile.mMeans.data()), profile.mMeans.size() * sizeof(float));
+		if (!out)
+		{
+			std::cerr << "Failed to write profile cache " << temporary.string() << std::endl;
+			out.close();
+			fs::remove(temporary, ec);
+			return false;
+		}
+	}
+
+	fs::rename(temporary, target, ec);
+	if (ec)
+	{
+		std::cerr << "Failed to replace profile cache " << path << ": " << ec.message() << std::endl;
+		fs::remove(temporary, ec);
+		return false;
+	}
+	return true;
+}
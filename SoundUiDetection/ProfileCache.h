@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "NoiseReduction.h"
+
+// Noise profiles kept on disk between runs, so a scene that was profiled
+// once loads in milliseconds instead of decoding and analysing its files
+// again.  A cache file is a fixed header (format version, rate, window
+// size, window types, steps per window, window count, a digest of the
+// source files and checksums) followed by the per-bin means.  It is memory
+// mapped to load, and rejected when it is damaged, of another version, or
+// made from other files or other settings; the caller then profiles anew
+// and saves over it.
+namespace ProfileCache
+{
+	// Identifies the noise a profile is made from by the paths, sizes and
+	// modification times of the files, in any order
+	uint64_t SourceDigest(const std::vector<std::string>& paths);
+
+	// True and the stored profile when path holds a valid cache for these
+	// sources, settings and rate; false when it is missing or stale
+	bool Load(const std::string& path, uint64_t sourceDigest,
+		const NoiseReduction::Settings& settings, double sampleRate, NoiseProfile& profile);
+
+	// Writes a temporary file next to path and renames it into place, so a
+	// reader never maps a half-written cache
+	bool Save(const std::string& path, uint64_t sourceDigest,
+		const NoiseReduction::Settings& settings, const NoiseProfile& profile);
+}
@@ -0,0 +1,89 @@
+#include "ProfileLibrary.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
+#include "ProfileBuilder.h"
+#include "ProfileCache.h"
+
+namespace fs = std::filesystem;
+
+ProfileLibrary::ProfileLibrary(const NoiseReduction::Settings& settings, double sampleRate, std::string cacheFolder)
+	: mSettings(settings)
+	, mSampleRate(sampleRate)
+	, mCacheFolder(std::move(cacheFolder))
+{
+}
+
+std::string ProfileLibrary::CachePath(const std::string& path) const
+{
+	// <file>.<size>x<steps>.w<types>.<rate>.nprof
+	const fs::path source(path);
+	const std::string key = std::to_string(mSettings.WindowSize()) + "x" + std::to_string(mSettings.StepsPerWindow()) +
+		".w" + std::to_string(mSettings.mWindowTypes) + "." + std::to_string(std::llround(mSampleRate));
+	return (fs::path(mCacheFolder) / source.parent_path().filename() / (source.filename().string() + "." + key + ".nprof")).string();
+}
+
+bool ProfileLibrary::Fits(const NoiseReduction::Settings& settings, double sampleRate) const
+{
+	return sampleRate == mSampleRate &&
+		settings.WindowSize() == mSettings.WindowSize() &&
+		settings.StepsPerWindow() == mSettings.StepsPerWindow() &&
+		settings.mWindowTypes == mSettings.mWindowTypes;
+}
+
+size_t ProfileLibrary::Size() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mEntries.size();
+}
+
+NoiseProfile ProfileLibrary::Scene(std::vector<std::string> paths)
+{
+	std::sort(paths.begin(), paths.end());
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+	std::vector<uint64_t> digests(paths.size());
+	for (size_t ff = 0; ff < paths.size(); ++ff)
+		digests[ff] = ProfileCache::SourceDigest({ paths[ff] });
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	// Entries missing from memory, or made from an older version of the file
+	std::vector<std::string> missing;
+	std::vector<uint64_t> missingDigests;
+	for (size_t ff = 0; ff < paths.size(); ++ff)
+	{
+		auto it = mEntries.find(paths[ff]);
+		if (it != mEntries.end() && it->second.digest == digests[ff])
+			continue;
+
+		NoiseProfile cached;
+		if (!mCacheFolder.empty() && ProfileCache::Load(CachePath(paths[ff]), digests[ff], mSettings, mSampleRate, cached))
+		{
+			mEntries[paths[ff]] = { digests[ff], std::move(cached) };
+			continue;
+		}
+
+		missing.push_back(paths[ff]);
+		missingDigests.push_back(digests[ff]);
+	}
+
+	if (!missing.empty())
+	{
+		std::vector<NoiseProfile> profiles = ProfileBuilder::ProfileFiles(missing, mSettings, mSampleRate);
+		for (size_t ff = 0; ff < missing.size(); ++ff)
+		{
+			// A file too short for a window is remembered, but not cached
+			if (!mCacheFolder.empty() && profiles[ff].mTotalWindows > 0)
+				ProfileCache::Save(CachePath(missing[ff]), missingDigests[ff], mSettings, profiles[ff]);
+			mEntries[missing[ff]] = { missingDigests[ff], std::move(profiles[ff]) };
+		}
+	}
+
+	NoiseProfile scene;
+	for (const auto& path : paths)
+		scene.Merge(mEntries[path].profile);
+	return scene;
+}
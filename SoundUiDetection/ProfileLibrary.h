@@ -0,0 +1,53 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "NoiseReduction.h"
+
+// The noise profile of every noise file on its own, for one set of profile
+// settings.  A scene (a map with or without rain and night) is the window-
+// weighted merge of the profiles of its files, so switching scenes costs a
+// merge over the bins once its files are known.  Entries come from memory,
+// then from one ProfileCache file per noise file, and only the rest are
+// profiled, in parallel by ProfileBuilder, and cached.  An entry is profiled
+// again when its file changes.
+class ProfileLibrary
+{
+public:
+	// Without a cache folder the library lives in memory only
+	ProfileLibrary(const NoiseReduction::Settings& settings, double sampleRate, std::string cacheFolder = "");
+
+	// The merged profile of the files, in path order whatever order they
+	// come in; files that cannot be read add nothing.  Safe to call from
+	// several threads.
+	NoiseProfile Scene(std::vector<std::string> paths);
+
+	// Where the cache file of a noise file goes: the cache folder, the
+	// name of the file's folder, then its own name and everything Fits
+	// compares (window size, steps, window types and rate), so the entries
+	// of every library are kept side by side
+	std::string CachePath(const std::string& path) const;
+
+	// Whether the entries also serve a reducer with these settings; the
+	// profile depends on the windows only, not on sensitivity or gain
+	bool Fits(const NoiseReduction::Settings& settings, double sampleRate) const;
+
+	size_t Size() const;
+
+private:
+	struct Entry
+	{
+		uint64_t digest;
+		NoiseProfile profile;
+	};
+
+	const NoiseReduction::Settings mSettings;
+	const double mSampleRate;
+	const std::string mCacheFolder;
+
+	mutable std::mutex mMutex;
+	std::map<std::string, Entry> mEntries;
+};
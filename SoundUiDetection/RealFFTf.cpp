@@ -37,15 +37,17 @@
 */
 
 //#include "Audacity.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <vector>
+#include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
 
 #include "RealFFTf.h"
-#ifdef EXPERIMENTAL_EQ_SSE_THREADED
-#include "RealFFTf48x.h"
-#endif
+#include "RealFFTfSimd.h"
 
 #ifndef M_PI
 #define	M_PI		3.14159265358979323846  /* pi */
@@ -55,10 +57,11 @@
 *  Initialize the Sine table and Twiddle pointers (bit-reversed pointers)
 *  for the FFT routine.
 */
-HFFT InitializeFFT(size_t fftlen)
+static std::unique_ptr<FFTParam> InitializeFFT(size_t fftlen, FFTVariant variant)
 {
     int temp;
-    HFFT h{ safenew FFTParam };
+    std::unique_ptr<FFTParam> h{ safenew FFTParam };
+    h->Variant = variant;
 
     /*
     *  FFT size is only half the number of data points
@@ -67,6 +70,18 @@ HFFT InitializeFFT(size_t fftlen)
     */
     h->Points = fftlen / 2;
 
+    if (variant == FFTVariant::Ordered)
+    {
+        h->TwiddleReal.reinit(h->Points);
+        h->TwiddleImag.reinit(h->Points);
+        for (size_t i = 0; i < h->Points; i++)
+        {
+            h->TwiddleReal[i] = (fft_type)cos(M_PI * i / h->Points);
+            h->TwiddleImag[i] = (fft_type)-sin(M_PI * i / h->Points);
+        }
+        return h;
+    }
+
     h->SinTable.reinit(2 * h->Points);
 
     h->BitReversed.reinit(h->Points);
@@ -96,52 +111,88 @@ HFFT InitializeFFT(size_t fftlen)
     return h;
 }
 
-enum : size_t { MAX_HFFT = 10 };
+/* Kernel selection: detected once, may be narrowed at run time */
+static const FFTKernel supportedKernel = DetectFFTKernel();
+static std::atomic<FFTKernel> activeKernel{ supportedKernel };
 
-// Maintain a pool:
-static std::vector< movable_ptr<FFTParam> > hFFTArray(MAX_HFFT);
-//wxCriticalSection getFFTMutex;
+FFTKernel GetFFTKernel()
+{
+    return activeKernel.load(std::memory_order_relaxed);
+}
 
-/* Get a handle to the FFT tables of the desired length */
-/* This version keeps common tables rather than allocating a NEW table every time */
-HFFT GetFFT(size_t fftlen)
+void SetFFTKernel(FFTKernel kernel)
 {
-    // To do:  smarter policy about when to retain in the pool and when to
-    // allocate a unique instance.
-
- //   wxCriticalSectionLocker locker{ getFFTMutex };
-
-    size_t h = 0;
-    auto n = fftlen / 2;
-    auto size = hFFTArray.size();
-    for (;
-        (h < size) && hFFTArray[h] && (n != hFFTArray[h]->Points);
-        h++)
-        ;
-    if (h < size) {
-        if (hFFTArray[h] == NULL) {
-            hFFTArray[h].reset(InitializeFFT(fftlen).release());
-        }
-        return HFFT{ hFFTArray[h].get() };
+    activeKernel.store(std::min(kernel, supportedKernel), std::memory_order_relaxed);
+}
+
+const char* FFTKernelName(FFTKernel kernel)
+{
+    switch (kernel) {
+    case FFTKernel::SSE2: return "SSE2";
+    case FFTKernel::AVX2: return "AVX2";
+    case FFTKernel::AVX512: return "AVX-512";
+    default: return "scalar";
+    }
+}
+
+/*
+*  Plan cache: one slot per variant and power of two size.  A slot is
+*  filled once, under the mutex, and then only read; the plan it points to
+*  lives as long as the program.  So a hit is one acquire load and a
+*  reference count increment, and never waits for a thread that is
+*  building another plan.
+*/
+enum : size_t { MAX_FFT_BITS = 32, FFT_VARIANTS = 2 };
+
+static HFFT planStorage[FFT_VARIANTS][MAX_FFT_BITS];
+static std::atomic<const HFFT*> planCache[FFT_VARIANTS][MAX_FFT_BITS];
+static std::mutex planCacheMutex;
+
+static std::atomic<uint64_t> planCacheHits{ 0 };
+static std::atomic<uint64_t> planCacheMisses{ 0 };
+static std::atomic<size_t> planCount{ 0 };
+
+/* Get a handle to the shared FFT tables of the desired length */
+HFFT GetFFT(size_t fftlen, FFTVariant variant)
+{
+    size_t bits = 0;
+    while (bits < MAX_FFT_BITS && ((size_t)1 << bits) < fftlen)
+        bits++;
+
+    if (bits == MAX_FFT_BITS || ((size_t)1 << bits) != fftlen) {
+        // Not a size the cache keeps, so allocate a NEW set of tables
+        planCacheMisses.fetch_add(1, std::memory_order_relaxed);
+        return InitializeFFT(fftlen, variant);
     }
-    else {
-        // All buffers used, so fall back to allocating a NEW set of tables
-        return InitializeFFT(fftlen);
+
+    auto& slot = planCache[(size_t)variant][bits];
+    if (const HFFT* plan = slot.load(std::memory_order_acquire)) {
+        planCacheHits.fetch_add(1, std::memory_order_relaxed);
+        return *plan;
+    }
+
+    std::lock_guard<std::mutex> locker{ planCacheMutex };
+    if (const HFFT* plan = slot.load(std::memory_order_relaxed)) {
+        // Another thread built it while this one waited
+        planCacheHits.fetch_add(1, std::memory_order_relaxed);
+        return *plan;
     }
+
+    planCacheMisses.fetch_add(1, std::memory_order_relaxed);
+    HFFT& storage = planStorage[(size_t)variant][bits];
+    storage = InitializeFFT(fftlen, variant);
+    planCount.fetch_add(1, std::memory_order_relaxed);
+    slot.store(&storage, std::memory_order_release);
+    return storage;
 }
 
-/* Release a previously requested handle to the FFT tables */
-void FFTDeleter::operator() (FFTParam* hFFT) const
+FFTCacheStats GetFFTCacheStats()
 {
-    //   wxCriticalSectionLocker locker{ getFFTMutex };
-
-    auto it = hFFTArray.begin(), end = hFFTArray.end();
-    while (it != end && it->get() != hFFT)
-        ++it;
-    if (it != end)
-        ;
-    else
-        delete hFFT;
+    return {
+        planCacheHits.load(std::memory_order_relaxed),
+        planCacheMisses.load(std::memory_order_relaxed),
+        planCount.load(std::memory_order_relaxed),
+    };
 }
 
 /*
@@ -171,7 +222,9 @@ void RealFFTf(fft_type* buffer, const FFTParam* h)
     const int* br1, * br2;
     fft_type HRplus, HRminus, HIplus, HIminus;
     fft_type v1, v2, sin, cos;
+    const FFTKernel kernel = GetFFTKernel();
 
+    assert(h->Variant == FFTVariant::BitReversed);
     auto ButterfliesPerGroup = h->Points / 2;
 
     /*
@@ -186,6 +239,11 @@ void RealFFTf(fft_type* buffer, const FFTParam* h)
 
     while (ButterfliesPerGroup > 0)
     {
+        if (ForwardButterfliesSimd(kernel, buffer, h, ButterfliesPerGroup)) {
+            ButterfliesPerGroup >>= 1;
+            continue;
+        }
+
         A = buffer;
         B = buffer + ButterfliesPerGroup * 2;
         sptr = h->SinTable.get();
@@ -211,8 +269,10 @@ void RealFFTf(fft_type* buffer, const FFTParam* h)
         ButterfliesPerGroup >>= 1;
     }
     /* Massage output to get the output for a real input sequence. */
-    br1 = h->BitReversed.get() + 1;
-    br2 = h->BitReversed.get() + h->Points - 1;
+    /* The SIMD kernels take the first pairs, the rest is done here */
+    const size_t unpacked = ForwardUnpackSimd(kernel, buffer, h);
+    br1 = h->BitReversed.get() + 1 + unpacked;
+    br2 = h->BitReversed.get() + h->Points - 1 - unpacked;
 
     while (br1 < br2)
     {
@@ -273,13 +333,17 @@ void InverseRealFFTf(fft_type* buffer, const FFTParam* h)
     const int* br1;
     fft_type HRplus, HRminus, HIplus, HIminus;
     fft_type v1, v2, sin, cos;
+    const FFTKernel kernel = GetFFTKernel();
 
+    assert(h->Variant == FFTVariant::BitReversed);
     auto ButterfliesPerGroup = h->Points / 2;
 
     /* Massage input to get the input for a real output sequence. */
-    A = buffer + 2;
-    B = buffer + h->Points * 2 - 2;
-    br1 = h->BitReversed.get() + 1;
+    /* The SIMD kernels take the first pairs, the rest is done here */
+    const size_t packed = InversePackSimd(kernel, buffer, h);
+    A = buffer + 2 + packed * 2;
+    B = buffer + h->Points * 2 - 2 - packed * 2;
+    br1 = h->BitReversed.get() + 1 + packed;
     while (A < B)
     {
         sin = h->SinTable[*br1];
@@ -323,6 +387,11 @@ void InverseRealFFTf(fft_type* buffer, const FFTParam* h)
 
     while (ButterfliesPerGroup > 0)
     {
+        if (InverseButterfliesSimd(kernel, buffer, h, ButterfliesPerGroup)) {
+            ButterfliesPerGroup >>= 1;
+            continue;
+        }
+
         A = buffer;
         B = buffer + ButterfliesPerGroup * 2;
         sptr = h->SinTable.get();
@@ -369,4 +438,196 @@ void ReorderToTime(const FFTParam* hFFT, const fft_type* buffer, fft_type* TimeO
         TimeOut[i * 2] = buffer[hFFT->BitReversed[i]];
         TimeOut[i * 2 + 1] = buffer[hFFT->BitReversed[i] + 1];
     }
-}
\ No newline at end of file
+}
+/*
+*  Natural-order variants.
+*
+*  The real sequence of length 2 * Points is taken as a complex sequence z of
+*  length Points (even samples real, odd samples imaginary), transformed with
+*  radix-2 Stockham passes, which read and write every pass in natural order
+*  at the cost of a second buffer, and split into the spectrum of the real
+*  sequence:  X[k] = E[k] + W^k O[k],  X[Points - k] = conj(E[k] - W^k O[k]),
+*  where E and O are the spectra of the even and odd samples and
+*  W = exp(-2 pi i / (2 * Points)).
+*
+*  Real and imaginary parts live in separate arrays, so every loop below
+*  streams through contiguous memory.
+*/
+
+/*
+*  One Stockham pass of half length m and stride s:
+*     y[q + s * 2p]       = (x[q + s * p] + x[q + s * (p + m)]) * scale
+*     y[q + s * (2p + 1)] = (x[q + s * p] - x[q + s * (p + m)]) * w^p * scale
+*  with w = exp(-+2 pi i / 2m).
+*/
+static void OrderedPass(FFTKernel kernel, const FFTParam* h, size_t m, size_t s, bool inverse,
+    fft_type scale, const fft_type* xr, const fft_type* xi, fft_type* yr, fft_type* yi)
+{
+    const fft_type imagSign = inverse ? -scale : scale;
+
+    if (OrderedPassSimd(kernel, h, m, s, scale, imagSign, xr, xi, yr, yi))
+        return;
+
+    if (s == 1) {
+        // First pass: a single butterfly per twiddle, so run along the twiddles
+        for (size_t p = 0; p < m; p++)
+        {
+            const fft_type wr = h->TwiddleReal[p * 2] * scale;
+            const fft_type wi = h->TwiddleImag[p * 2] * imagSign;
+            const fft_type dr = xr[p] - xr[p + m];
+            const fft_type di = xi[p] - xi[p + m];
+            yr[2 * p] = (xr[p] + xr[p + m]) * scale;
+            yi[2 * p] = (xi[p] + xi[p + m]) * scale;
+            yr[2 * p + 1] = dr * wr - di * wi;
+            yi[2 * p + 1] = dr * wi + di * wr;
+        }
+        return;
+    }
+
+    for (size_t p = 0; p < m; p++)
+    {
+        const fft_type wr = h->TwiddleReal[p * 2 * s] * scale;
+        const fft_type wi = h->TwiddleImag[p * 2 * s] * imagSign;
+        const fft_type* ar = xr + s * p;
+        const fft_type* ai = xi + s * p;
+        const fft_type* br = xr + s * (p + m);
+        const fft_type* bi = xi + s * (p + m);
+        fft_type* sumr = yr + s * 2 * p;
+        fft_type* sumi = yi + s * 2 * p;
+        fft_type* difr = sumr + s;
+        fft_type* difi = sumi + s;
+        for (size_t q = 0; q < s; q++)
+        {
+            const fft_type dr = ar[q] - br[q];
+            const fft_type di = ai[q] - bi[q];
+            sumr[q] = (ar[q] + br[q]) * scale;
+            sumi[q] = (ai[q] + bi[q]) * scale;
+            difr[q] = dr * wr - di * wi;
+            difi[q] = dr * wi + di * wr;
+        }
+    }
+}
+
+static size_t OrderedPassCount(const FFTParam* h)
+{
+    size_t count = 0;
+    for (size_t m = h->Points / 2; m > 0; m >>= 1)
+        count++;
+    return count;
+}
+
+/*
+*  Forward FFT in natural order.  Must call GetFFT(fftlen) first!
+*
+*  buffer holds the fftlen real input samples and is overwritten.
+*  RealOut and ImagOut receive bins 0 (DC) to Points (Fs/2), scaled as
+*  RealFFTf.
+*/
+void RealFFTfOrdered(const FFTParam* hFFT, fft_type* buffer,
+    fft_type* RealOut, fft_type* ImagOut)
+{
+    const size_t points = hFFT->Points;
+    const FFTKernel kernel = GetFFTKernel();
+
+    assert(hFFT->Variant == FFTVariant::Ordered);
+    for (size_t i = SplitSimd(kernel, buffer, RealOut, ImagOut, points); i < points; i++)
+    {
+        RealOut[i] = buffer[2 * i];
+        ImagOut[i] = buffer[2 * i + 1];
+    }
+
+    // Ping-pong between the outputs and the two halves of buffer
+    fft_type* xr = RealOut, * xi = ImagOut;
+    fft_type* yr = buffer, * yi = buffer + points;
+    for (size_t m = points / 2, s = 1; m > 0; m >>= 1, s <<= 1)
+    {
+        OrderedPass(kernel, hFFT, m, s, false, 1, xr, xi, yr, yi);
+        std::swap(xr, yr);
+        std::swap(xi, yi);
+    }
+
+    /* Split Z into the spectrum of the real sequence, pairing k with Points - k */
+    const fft_type zr0 = xr[0], zi0 = xi[0];
+    const size_t unpacked = OrderedUnpackSimd(kernel, hFFT, xr, xi, RealOut, ImagOut);
+    for (size_t k = 1 + unpacked, j = points - 1 - unpacked; k <= j; k++, j--)
+    {
+        // E = (Z[k] + conj Z[j]) / 2,  O = (Z[k] - conj Z[j]) / 2i
+        const fft_type er = (xr[k] + xr[j]) * (fft_type)0.5;
+        const fft_type ei = (xi[k] - xi[j]) * (fft_type)0.5;
+        const fft_type or_ = (xi[k] + xi[j]) * (fft_type)0.5;
+        const fft_type oi = (xr[j] - xr[k]) * (fft_type)0.5;
+        const fft_type wr = hFFT->TwiddleReal[k];
+        const fft_type wi = hFFT->TwiddleImag[k];
+        const fft_type tr = wr * or_ - wi * oi;
+        const fft_type ti = wr * oi + wi * or_;
+        RealOut[k] = er + tr;
+        ImagOut[k] = ei + ti;
+        RealOut[j] = er - tr;
+        ImagOut[j] = ti - ei;
+    }
+    /* DC and Fs/2 bins are the sum and difference of the even and odd sums */
+    RealOut[0] = zr0 + zi0;
+    ImagOut[0] = 0;
+    RealOut[points] = zr0 - zi0;
+    ImagOut[points] = 0;
+}
+
+/*
+*  Inverse FFT in natural order.  Must call GetFFT(fftlen) first!
+*
+*  RealIn and ImagIn hold bins 0 (DC) to Points (Fs/2) and are overwritten.
+*  TimeOut receives the fftlen real samples, scaled as InverseRealFFTf.
+*/
+void InverseRealFFTfOrdered(const FFTParam* hFFT, fft_type* RealIn,
+    fft_type* ImagIn, fft_type* TimeOut)
+{
+    const size_t points = hFFT->Points;
+    const FFTKernel kernel = GetFFTKernel();
+
+    assert(hFFT->Variant == FFTVariant::Ordered);
+    // Start where an even number of passes later ends back in RealIn/ImagIn
+    fft_type* xr = RealIn, * xi = ImagIn;
+    fft_type* yr = TimeOut, * yi = TimeOut + points;
+    if (OrderedPassCount(hFFT) % 2)
+    {
+        std::swap(xr, yr);
+        std::swap(xi, yi);
+    }
+
+    /* Rebuild Z = E + i O from the spectrum of the real sequence */
+    const fft_type dc = RealIn[0], nyquist = RealIn[points];
+    const size_t packed = OrderedPackSimd(kernel, hFFT, RealIn, ImagIn, xr, xi);
+    for (size_t k = 1 + packed, j = points - 1 - packed; k <= j; k++, j--)
+    {
+        // E = (X[k] + conj X[j]) / 2,  O = conj(W^k) (X[k] - conj X[j]) / 2
+        const fft_type er = (RealIn[k] + RealIn[j]) * (fft_type)0.5;
+        const fft_type ei = (ImagIn[k] - ImagIn[j]) * (fft_type)0.5;
+        const fft_type dr = (RealIn[k] - RealIn[j]) * (fft_type)0.5;
+        const fft_type di = (ImagIn[k] + ImagIn[j]) * (fft_type)0.5;
+        const fft_type wr = hFFT->TwiddleReal[k];
+        const fft_type wi = hFFT->TwiddleImag[k];
+        const fft_type or_ = wr * dr + wi * di;
+        const fft_type oi = wr * di - wi * dr;
+        // Z[k] = E + i O,  Z[j] = conj E + i conj O
+        xr[k] = er - oi;
+        xi[k] = ei + or_;
+        xr[j] = er + oi;
+        xi[j] = or_ - ei;
+    }
+    xr[0] = (dc + nyquist) * (fft_type)0.5;
+    xi[0] = (dc - nyquist) * (fft_type)0.5;
+
+    for (size_t m = points / 2, s = 1; m > 0; m >>= 1, s <<= 1)
+    {
+        OrderedPass(kernel, hFFT, m, s, true, (fft_type)0.5, xr, xi, yr, yi);
+        std::swap(xr, yr);
+        std::swap(xi, yi);
+    }
+
+    /* Even samples are the real parts, odd samples the imaginary parts */
+    for (size_t i = MergeSimd(kernel, xr, xi, TimeOut, points); i < points; i++)
+    {
+        TimeOut[2 * i] = xr[i];
+        TimeOut[2 * i + 1] = xi[i];
+    }
+}
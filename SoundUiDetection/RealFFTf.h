@@ -3,30 +3,95 @@
 
 #include "MemoryX.h"
 
+#include <atomic>
+#include <cstdint>
+#include <new>
+
 using fft_type = float;
+
+// Table storage for the FFT plans: each table starts on its own cache
+// line, so the SIMD kernels never split a twiddle load across two lines
+// at the start of a table, and two tables never share a line.
+template<typename T>
+class AlignedArrayOf
+{
+public:
+	static constexpr size_t Alignment = 64;
+
+	void reinit(size_t count)
+	{
+		mData.reset(static_cast<T*>(::operator new[](count * sizeof(T), std::align_val_t{ Alignment })));
+	}
+
+	T* get() const { return mData.get(); }
+	T& operator [] (size_t index) const { return mData.get()[index]; }
+	explicit operator bool () const { return mData != nullptr; }
+
+private:
+	struct Deleter {
+		void operator () (T* p) const { ::operator delete[](p, std::align_val_t{ Alignment }); }
+	};
+	std::unique_ptr<T, Deleter> mData;
+};
+
+// Which tables a plan carries
+enum class FFTVariant {
+	BitReversed,	// RealFFTf, InverseRealFFTf and the Reorder functions
+	Ordered,		// RealFFTfOrdered and InverseRealFFTfOrdered
+};
+
+// An FFT plan.  Plans come from GetFFT fully built and are never modified
+// afterwards, so one plan is shared by every thread that uses its size.
 struct FFTParam {
-	ArrayOf<int> BitReversed;
-	ArrayOf<fft_type> SinTable;
+	FFTVariant Variant;
 	size_t Points;
+	// BitReversed variant
+	AlignedArrayOf<int> BitReversed;
+	AlignedArrayOf<fft_type> SinTable;
+	// Ordered variant: exp(-2 pi i k / (2 * Points)) for k < Points, in
+	// natural order
+	AlignedArrayOf<fft_type> TwiddleReal;
+	AlignedArrayOf<fft_type> TwiddleImag;
 #ifdef EXPERIMENTAL_EQ_SSE_THREADED
 	int pow2Bits;
 #endif
 };
 
-struct FFTDeleter {
-	void operator () (FFTParam* p) const;
-};
+using HFFT = std::shared_ptr<const FFTParam>;
+
+// Instruction sets RealFFTf and InverseRealFFTf can run on, narrowest first
+enum class FFTKernel { Scalar, SSE2, AVX2, AVX512 };
+
+// Kernel in use; the widest one the CPU supports unless narrowed by SetFFTKernel
+FFTKernel GetFFTKernel();
+// Narrow the kernel, e.g. to compare against the scalar code; clamped to the CPU
+void SetFFTKernel(FFTKernel);
+const char* FFTKernelName(FFTKernel);
 
-using HFFT = std::unique_ptr<
-	FFTParam, FFTDeleter
->;
+// The shared plan for a power of two fftlen.  Thread safe; a plan that is
+// already cached is found without taking a lock.
+HFFT GetFFT(size_t fftlen, FFTVariant variant = FFTVariant::BitReversed);
+
+struct FFTCacheStats {
+	uint64_t hits;
+	uint64_t misses;	// each miss builds one plan
+	size_t plans;
+};
+FFTCacheStats GetFFTCacheStats();
 
-HFFT GetFFT(size_t);
 void RealFFTf(fft_type*, const FFTParam*);
 void InverseRealFFTf(fft_type*, const FFTParam*);
 void ReorderToTime(const FFTParam* hFFT, const fft_type* buffer, fft_type* TimeOut);
 void ReorderToFreq(const FFTParam* hFFT, const fft_type* buffer,
 	fft_type* RealOut, fft_type* ImagOut);
 
+// Natural-order variants with split real/imaginary spectra of Points + 1 bins.
+// RealFFTfOrdered uses buffer as scratch; ImagOut[0] and ImagOut[Points] are 0.
+// InverseRealFFTfOrdered ignores those two and uses RealIn and ImagIn as scratch.
+void RealFFTfOrdered(const FFTParam* hFFT, fft_type* buffer,
+	fft_type* RealOut, fft_type* ImagOut);
+void InverseRealFFTfOrdered(const FFTParam* hFFT, fft_type* RealIn,
+	fft_type* ImagIn, fft_type* TimeOut);
+
 #endif
 #pragma once
@@ -0,0 +1,906 @@
+/*
+*  SIMD butterfly passes and real-sequence (un)packing for RealFFTf.cpp.
+*
+*  The data layout is the one of RealFFTf: interleaved (real, imaginary)
+*  pairs, with the twiddles for pass groups stored as (sin, cos) pairs in
+*  SinTable.  Within a group every butterfly uses the same twiddle, so a
+*  vector holds consecutive butterflies of one group:
+*
+*     W = B * (cos, cos) + swap(B) * (sin, -sin)     (forward)
+*     Bout = A + W,  Aout = Bout - 2 * W
+*
+*     W = B * (cos, cos) + swap(B) * (-sin, sin)     (inverse)
+*     Bout = (A + W) / 2,  Aout = Bout - W
+*
+*  which is the scalar code with the imaginary part of v2 negated.  The
+*  last passes have fewer butterflies per group than a vector has lanes;
+*  AVX-512 and AVX2 hand those to the narrower kernels, and the one-butterfly
+*  pass takes two groups per SSE vector.
+*
+*  The (un)packing pairs bin k with bin N/2 - k.  The forward bins and the
+*  twiddles of both directions sit at bit-reversed positions, so the wide
+*  kernels gather them; AVX-512 also scatters the forward results.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "RealFFTfSimd.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FFT_X86_KERNELS 1
+#else
+#define FFT_X86_KERNELS 0
+#endif
+
+#if FFT_X86_KERNELS
+
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// MSVC compiles any intrinsic anywhere; GCC and Clang want the target per function
+#if defined(_MSC_VER) && !defined(__clang__)
+#define FFT_TARGET_SSE2
+#define FFT_TARGET_AVX2
+#define FFT_TARGET_AVX512
+#else
+#define FFT_TARGET_SSE2 __attribute__((target("sse2")))
+#define FFT_TARGET_AVX2 __attribute__((target("avx2")))
+#define FFT_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+// The AVX-512 target brings FMA along; fusing would change the rounding
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace {
+
+    /* ---------------------------------------------------------------- SSE2 */
+
+    // Two (real, imaginary) pairs from anywhere into one vector, and back
+    FFT_TARGET_SSE2 inline __m128 LoadPairs(const fft_type* p0, const fft_type* p1)
+    {
+        return _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)p0), (const __m64*)p1);
+    }
+
+    FFT_TARGET_SSE2 inline void StorePairs(fft_type* p0, fft_type* p1, __m128 v)
+    {
+        _mm_storel_pi((__m64*)p0, v);
+        _mm_storeh_pi((__m64*)p1, v);
+    }
+
+    // Imaginary lanes from b, real lanes from a
+    FFT_TARGET_SSE2 inline __m128 BlendImag(__m128 a, __m128 b)
+    {
+        const __m128 imag = _mm_castsi128_ps(_mm_setr_epi32(0, -1, 0, -1));
+        return _mm_or_ps(_mm_and_ps(imag, b), _mm_andnot_ps(imag, a));
+    }
+
+    template<bool Inverse>
+    FFT_TARGET_SSE2 inline void ButterflySSE2(fft_type* A, fft_type* B, __m128 cc, __m128 ss)
+    {
+        const __m128 a = _mm_loadu_ps(A);
+        const __m128 b = _mm_loadu_ps(B);
+        const __m128 w = _mm_add_ps(_mm_mul_ps(b, cc),
+            _mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1)), ss));
+        if (Inverse) {
+            const __m128 bOut = _mm_mul_ps(_mm_add_ps(a, w), _mm_set1_ps(0.5f));
+            _mm_storeu_ps(B, bOut);
+            _mm_storeu_ps(A, _mm_sub_ps(bOut, w));
+        }
+        else {
+            const __m128 bOut = _mm_add_ps(a, w);
+            _mm_storeu_ps(B, bOut);
+            _mm_storeu_ps(A, _mm_sub_ps(bOut, _mm_add_ps(w, w)));
+        }
+    }
+
+    FFT_TARGET_SSE2 inline __m128 SignSSE2(bool inverse)
+    {
+        return inverse ? _mm_setr_ps(-1, 1, -1, 1) : _mm_setr_ps(1, -1, 1, -1);
+    }
+
+    // Two or more butterflies per group
+    template<bool Inverse>
+    FFT_TARGET_SSE2 void PassSSE2(fft_type* buffer, const fft_type* sptr, size_t points, size_t butterfliesPerGroup)
+    {
+        const __m128 sign = SignSSE2(Inverse);
+        const size_t half = butterfliesPerGroup * 2;
+        for (fft_type* A = buffer, *end = buffer + points * 2; A < end; A += half * 2, sptr += 2) {
+            const __m128 ss = _mm_mul_ps(_mm_set1_ps(sptr[0]), sign);
+            const __m128 cc = _mm_set1_ps(sptr[1]);
+            fft_type* B = A + half;
+            for (size_t k = 0; k < half; k += 4)
+                ButterflySSE2<Inverse>(A + k, B + k, cc, ss);
+        }
+    }
+
+    // One butterfly per group: groups g and g+1 share a vector,
+    // A0 A1 in one and B0 B1 in the other, with their own twiddles
+    template<bool Inverse>
+    FFT_TARGET_SSE2 void PairPassSSE2(fft_type* buffer, const fft_type* sptr, size_t points)
+    {
+        const __m128 sign = SignSSE2(Inverse);
+        for (fft_type* p = buffer, *end = buffer + points * 2; p < end; p += 8, sptr += 4) {
+            const __m128 x0 = _mm_loadu_ps(p);
+            const __m128 x1 = _mm_loadu_ps(p + 4);
+            const __m128 t = _mm_loadu_ps(sptr);
+            const __m128 a = _mm_movelh_ps(x0, x1);
+            const __m128 b = _mm_movehl_ps(x1, x0);
+            const __m128 cc = _mm_shuffle_ps(t, t, _MM_SHUFFLE(3, 3, 1, 1));
+            const __m128 ss = _mm_mul_ps(_mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 0, 0)), sign);
+            const __m128 w = _mm_add_ps(_mm_mul_ps(b, cc),
+                _mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1)), ss));
+            __m128 aOut, bOut;
+            if (Inverse) {
+                bOut = _mm_mul_ps(_mm_add_ps(a, w), _mm_set1_ps(0.5f));
+                aOut = _mm_sub_ps(bOut, w);
+            }
+            else {
+                bOut = _mm_add_ps(a, w);
+                aOut = _mm_sub_ps(bOut, _mm_add_ps(w, w));
+            }
+            _mm_storeu_ps(p, _mm_movelh_ps(aOut, bOut));
+            _mm_storeu_ps(p + 4, _mm_movehl_ps(bOut, aOut));
+        }
+    }
+
+    /*
+    *  The real-sequence fix-up of a bin pair (A, B) with twiddle T = (sin, cos):
+    *     X = A - B = (HRminus, HIminus),  Y = X + 2B = (HRplus, HIplus)
+    *     forward: V = (v1, v2)  = X.re * (sin, cos) + Y.im * (-cos, sin)
+    *     inverse: V = (v1, -v2) = X.re * (sin, -cos) + Y.im * (cos, sin)
+    *     A = ((HRplus, HIminus) + V) / 2,  B = A - (V.re, HIminus)
+    */
+    template<bool Inverse>
+    FFT_TARGET_SSE2 inline void FixUpSSE2(__m128& a, __m128& b, __m128 t)
+    {
+        const __m128 x = _mm_sub_ps(a, b);
+        const __m128 y = _mm_add_ps(x, _mm_add_ps(b, b));
+        const __m128 xRe = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 2, 0, 0));
+        const __m128 yIm = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 1, 1));
+        const __m128 swapped = _mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 3, 0, 1));
+        const __m128 v = Inverse
+            ? _mm_add_ps(_mm_mul_ps(xRe, _mm_mul_ps(t, _mm_setr_ps(1, -1, 1, -1))), _mm_mul_ps(yIm, swapped))
+            : _mm_add_ps(_mm_mul_ps(xRe, t), _mm_mul_ps(yIm, _mm_mul_ps(swapped, _mm_setr_ps(-1, 1, -1, 1))));
+        a = _mm_mul_ps(_mm_add_ps(BlendImag(y, x), v), _mm_set1_ps(0.5f));
+        b = _mm_sub_ps(a, BlendImag(v, x));
+    }
+
+    FFT_TARGET_SSE2 size_t ForwardUnpackSSE2(fft_type* buffer, const FFTParam* h, size_t i, size_t end)
+    {
+        const int* br = h->BitReversed.get();
+        const fft_type* sinTable = h->SinTable.get();
+        for (; i + 2 <= end; i += 2) {
+            fft_type* A0 = buffer + br[i];
+            fft_type* A1 = buffer + br[i + 1];
+            fft_type* B0 = buffer + br[h->Points - i];
+            fft_type* B1 = buffer + br[h->Points - i - 1];
+            __m128 a = LoadPairs(A0, A1);
+            __m128 b = LoadPairs(B0, B1);
+            FixUpSSE2<false>(a, b, LoadPairs(sinTable + br[i], sinTable + br[i + 1]));
+            StorePairs(A0, A1, a);
+            StorePairs(B0, B1, b);
+        }
+        return i;
+    }
+
+    FFT_TARGET_SSE2 size_t InversePackSSE2(fft_type* buffer, const FFTParam* h, size_t i, size_t end)
+    {
+        const int* br = h->BitReversed.get();
+        const fft_type* sinTable = h->SinTable.get();
+        for (; i + 2 <= end; i += 2) {
+            // B runs downwards from the top bin, so its two pairs come in swapped
+            fft_type* A = buffer + i * 2;
+            fft_type* B = buffer + (h->Points - i - 1) * 2;
+            __m128 a = _mm_loadu_ps(A);
+            __m128 b = _mm_loadu_ps(B);
+            b = _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2));
+            FixUpSSE2<true>(a, b, LoadPairs(sinTable + br[i], sinTable + br[i + 1]));
+            _mm_storeu_ps(A, a);
+            _mm_storeu_ps(B, _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2)));
+        }
+        return i;
+    }
+
+    /* ---------------------------------------------------------------- AVX2 */
+
+    FFT_TARGET_AVX2 inline __m256 SignAVX2(bool inverse)
+    {
+        return inverse ? _mm256_setr_ps(-1, 1, -1, 1, -1, 1, -1, 1) : _mm256_setr_ps(1, -1, 1, -1, 1, -1, 1, -1);
+    }
+
+    // Four or more butterflies per group
+    template<bool Inverse>
+    FFT_TARGET_AVX2 void PassAVX2(fft_type* buffer, const fft_type* sptr, size_t points, size_t butterfliesPerGroup)
+    {
+        const __m256 sign = SignAVX2(Inverse);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const size_t span = butterfliesPerGroup * 2;
+        for (fft_type* A = buffer, *end = buffer + points * 2; A < end; A += span * 2, sptr += 2) {
+            const __m256 ss = _mm256_mul_ps(_mm256_set1_ps(sptr[0]), sign);
+            const __m256 cc = _mm256_set1_ps(sptr[1]);
+            fft_type* B = A + span;
+            for (size_t k = 0; k < span; k += 8) {
+                const __m256 a = _mm256_loadu_ps(A + k);
+                const __m256 b = _mm256_loadu_ps(B + k);
+                const __m256 w = _mm256_add_ps(_mm256_mul_ps(b, cc),
+                    _mm256_mul_ps(_mm256_permute_ps(b, _MM_SHUFFLE(2, 3, 0, 1)), ss));
+                if (Inverse) {
+                    const __m256 bOut = _mm256_mul_ps(_mm256_add_ps(a, w), half);
+                    _mm256_storeu_ps(B + k, bOut);
+                    _mm256_storeu_ps(A + k, _mm256_sub_ps(bOut, w));
+                }
+                else {
+                    const __m256 bOut = _mm256_add_ps(a, w);
+                    _mm256_storeu_ps(B + k, bOut);
+                    _mm256_storeu_ps(A + k, _mm256_sub_ps(bOut, _mm256_add_ps(w, w)));
+                }
+            }
+        }
+        _mm256_zeroupper();
+    }
+
+    template<bool Inverse>
+    FFT_TARGET_AVX2 inline void FixUpAVX2(__m256& a, __m256& b, __m256 t)
+    {
+        const __m256 x = _mm256_sub_ps(a, b);
+        const __m256 y = _mm256_add_ps(x, _mm256_add_ps(b, b));
+        const __m256 xRe = _mm256_moveldup_ps(x);
+        const __m256 yIm = _mm256_movehdup_ps(y);
+        const __m256 swapped = _mm256_permute_ps(t, _MM_SHUFFLE(2, 3, 0, 1));
+        const __m256 v = Inverse
+            ? _mm256_add_ps(_mm256_mul_ps(xRe, _mm256_mul_ps(t, SignAVX2(false))), _mm256_mul_ps(yIm, swapped))
+            : _mm256_add_ps(_mm256_mul_ps(xRe, t), _mm256_mul_ps(yIm, _mm256_mul_ps(swapped, SignAVX2(true))));
+        a = _mm256_mul_ps(_mm256_add_ps(_mm256_blend_ps(y, x, 0xAA), v), _mm256_set1_ps(0.5f));
+        b = _mm256_sub_ps(a, _mm256_blend_ps(v, x, 0xAA));
+    }
+
+    // Four pairs at the float offsets in index, each pair read as one double
+    FFT_TARGET_AVX2 inline __m256 GatherPairsAVX2(const fft_type* base, __m128i index)
+    {
+        return _mm256_castpd_ps(_mm256_i32gather_pd((const double*)base, index, sizeof(fft_type)));
+    }
+
+    FFT_TARGET_AVX2 inline void StorePairsAVX2(fft_type* base, const int* index, __m256 v)
+    {
+        StorePairs(base + index[0], base + index[1], _mm256_castps256_ps128(v));
+        StorePairs(base + index[2], base + index[3], _mm256_extractf128_ps(v, 1));
+    }
+
+    FFT_TARGET_AVX2 size_t ForwardUnpackAVX2(fft_type* buffer, const FFTParam* h, size_t i, size_t end)
+    {
+        const int* br = h->BitReversed.get();
+        const fft_type* sinTable = h->SinTable.get();
+        for (; i + 4 <= end; i += 4) {
+            const __m128i ia = _mm_loadu_si128((const __m128i*)(br + i));
+            const __m128i ib = _mm_shuffle_epi32(
+                _mm_loadu_si128((const __m128i*)(br + h->Points - i - 3)), _MM_SHUFFLE(0, 1, 2, 3));
+            __m256 a = GatherPairsAVX2(buffer, ia);
+            __m256 b = GatherPairsAVX2(buffer, ib);
+            FixUpAVX2<false>(a, b, GatherPairsAVX2(sinTable, ia));
+
+            alignas(16) int indexB[4];
+            _mm_store_si128((__m128i*)indexB, ib);
+            StorePairsAVX2(buffer, br + i, a);
+            StorePairsAVX2(buffer, indexB, b);
+        }
+        _mm256_zeroupper();
+        return i;
+    }
+
+    FFT_TARGET_AVX2 size_t InversePackAVX2(fft_type* buffer, const FFTParam* h, size_t i, size_t end)
+    {
+        const int* br = h->BitReversed.get();
+        const fft_type* sinTable = h->SinTable.get();
+        for (; i + 4 <= end; i += 4) {
+            fft_type* A = buffer + i * 2;
+            fft_type* B = buffer + (h->Points - i - 3) * 2;
+            __m256 a = _mm256_loadu_ps(A);
+            __m256 b = _mm256_castpd_ps(_mm256_permute4x64_pd(
+                _mm256_castps_pd(_mm256_loadu_ps(B)), _MM_SHUFFLE(0, 1, 2, 3)));
+            FixUpAVX2<true>(a, b, GatherPairsAVX2(sinTable, _mm_loadu_si128((const __m128i*)(br + i))));
+            _mm256_storeu_ps(A, a);
+            _mm256_storeu_ps(B, _mm256_castpd_ps(_mm256_permute4x64_pd(
+                _mm256_castps_pd(b), _MM_SHUFFLE(0, 1, 2, 3))));
+        }
+        _mm256_zeroupper();
+        return i;
+    }
+
+    /* ------------------------------------------------------------- AVX-512 */
+
+    FFT_TARGET_AVX512 inline __m512 SignAVX512(bool inverse)
+    {
+        return inverse
+            ? _mm512_setr_ps(-1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1)
+            : _mm512_setr_ps(1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1);
+    }
+
+    // Eight or more butterflies per group
+    template<bool Inverse>
+    FFT_TARGET_AVX512 void PassAVX512(fft_type* buffer, const fft_type* sptr, size_t points, size_t butterfliesPerGroup)
+    {
+        const __m512 sign = SignAVX512(Inverse);
+        const __m512 half = _mm512_set1_ps(0.5f);
+        const size_t span = butterfliesPerGroup * 2;
+        for (fft_type* A = buffer, *end = buffer + points * 2; A < end; A += span * 2, sptr += 2) {
+            const __m512 ss = _mm512_mul_ps(_mm512_set1_ps(sptr[0]), sign);
+            const __m512 cc = _mm512_set1_ps(sptr[1]);
+            fft_type* B = A + span;
+            for (size_t k = 0; k < span; k += 16) {
+                const __m512 a = _mm512_loadu_ps(A + k);
+                const __m512 b = _mm512_loadu_ps(B + k);
+                const __m512 w = _mm512_add_ps(_mm512_mul_ps(b, cc),
+                    _mm512_mul_ps(_mm512_permute_ps(b, _MM_SHUFFLE(2, 3, 0, 1)), ss));
+                if (Inverse) {
+                    const __m512 bOut = _mm512_mul_ps(_mm512_add_ps(a, w), half);
+                    _mm512_storeu_ps(B + k, bOut);
+                    _mm512_storeu_ps(A + k, _mm512_sub_ps(bOut, w));
+                }
+                else {
+                    const __m512 bOut = _mm512_add_ps(a, w);
+                    _mm512_storeu_ps(B + k, bOut);
+                    _mm512_storeu_ps(A + k, _mm512_sub_ps(bOut, _mm512_add_ps(w, w)));
+                }
+            }
+        }
+        _mm256_zeroupper();
+    }
+
+    template<bool Inverse>
+    FFT_TARGET_AVX512 inline void FixUpAVX512(__m512& a, __m512& b, __m512 t)
+    {
+        const __m512 x = _mm512_sub_ps(a, b);
+        const __m512 y = _mm512_add_ps(x, _mm512_add_ps(b, b));
+        const __m512 xRe = _mm512_moveldup_ps(x);
+        const __m512 yIm = _mm512_movehdup_ps(y);
+        const __m512 swapped = _mm512_permute_ps(t, _MM_SHUFFLE(2, 3, 0, 1));
+        const __m512 v = Inverse
+            ? _mm512_add_ps(_mm512_mul_ps(xRe, _mm512_mul_ps(t, SignAVX512(false))), _mm512_mul_ps(yIm, swapped))
+            : _mm512_add_ps(_mm512_mul_ps(xRe, t), _mm512_mul_ps(yIm, _mm512_mul_ps(swapped, SignAVX512(true))));
+        a = _mm512_mul_ps(_mm512_add_ps(_mm512_mask_blend_ps(0xAAAA, y, x), v), _mm512_set1_ps(0.5f));
+        b = _mm512_sub_ps(a, _mm512_mask_blend_ps(0xAAAA, v, x));
+    }
+
+    FFT_TARGET_AVX512 inline __m512 GatherPairsAVX512(const fft_type* base, __m256i index)
+    {
+        return _mm512_castpd_ps(_mm512_i32gather_pd(index, (const double*)base, sizeof(fft_type)));
+    }
+
+    FFT_TARGET_AVX512 inline void ScatterPairsAVX512(fft_type* base, __m256i index, __m512 v)
+    {
+        _mm512_i32scatter_pd((double*)base, index, _mm512_castps_pd(v), sizeof(fft_type));
+    }
+
+    FFT_TARGET_AVX512 size_t ForwardUnpackAVX512(fft_type* buffer, const FFTParam* h, size_t i, size_t end)
+    {
+        const int* br = h->BitReversed.get();
+        const fft_type* sinTable = h->SinTable.get();
+        const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        for (; i + 8 <= end; i += 8) {
+            const __m256i ia = _mm256_loadu_si256((const __m256i*)(br + i));
+            const __m256i ib = _mm256_permutevar8x32_epi32(
+                _mm256_loadu_si256((const __m256i*)(br + h->Points - i - 7)), reverse);
+            __m512 a = GatherPairsAVX512(buffer, ia);
+            __m512 b = GatherPairsAVX512(buffer, ib);
+            FixUpAVX512<false>(a, b, GatherPairsAVX512(sinTable, ia));
+            ScatterPairsAVX512(buffer, ia, a);
+            ScatterPairsAVX512(buffer, ib, b);
+        }
+        _mm256_zeroupper();
+        return i;
+    }
+
+    FFT_TARGET_AVX512 size_t InversePackAVX512(fft_type* buffer, const FFTParam* h, size_t i, size_t end)
+    {
+        const int* br = h->BitReversed.get();
+        const fft_type* sinTable = h->SinTable.get();
+        const __m512i reverse = _mm512_setr_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+        for (; i + 8 <= end; i += 8) {
+            fft_type* A = buffer + i * 2;
+            fft_type* B = buffer + (h->Points - i - 7) * 2;
+            __m512 a = _mm512_loadu_ps(A);
+            __m512 b = _mm512_castpd_ps(_mm512_permutexvar_pd(reverse, _mm512_castps_pd(_mm512_loadu_ps(B))));
+            FixUpAVX512<true>(a, b, GatherPairsAVX512(sinTable, _mm256_loadu_si256((const __m256i*)(br + i))));
+            _mm512_storeu_ps(A, a);
+            _mm512_storeu_ps(B, _mm512_castpd_ps(_mm512_permutexvar_pd(reverse, _mm512_castps_pd(b))));
+        }
+        _mm256_zeroupper();
+        return i;
+    }
+
+    /* ------------------------------------------------- ordered variants */
+
+    /*
+    *  Stockham passes on split arrays.  With at least a vector of
+    *  butterflies per twiddle (s >= lanes) the loads and stores are
+    *  contiguous runs; the first two passes run along the twiddles instead
+    *  and interleave sums and differences on the way out.
+    */
+
+    FFT_TARGET_SSE2 inline void OrderedButterflySSE2(__m128 ar, __m128 ai, __m128 br, __m128 bi,
+        __m128 wr, __m128 wi, __m128 scale, __m128& sumr, __m128& sumi, __m128& difr, __m128& difi)
+    {
+        const __m128 dr = _mm_sub_ps(ar, br);
+        const __m128 di = _mm_sub_ps(ai, bi);
+        sumr = _mm_mul_ps(_mm_add_ps(ar, br), scale);
+        sumi = _mm_mul_ps(_mm_add_ps(ai, bi), scale);
+        difr = _mm_sub_ps(_mm_mul_ps(dr, wr), _mm_mul_ps(di, wi));
+        difi = _mm_add_ps(_mm_mul_ps(dr, wi), _mm_mul_ps(di, wr));
+    }
+
+    FFT_TARGET_SSE2 void OrderedPassSSE2(const FFTParam* h, size_t m, size_t s, fft_type scale, fft_type imagScale,
+        const fft_type* xr, const fft_type* xi, fft_type* yr, fft_type* yi)
+    {
+        const __m128 sc = _mm_set1_ps(scale);
+        __m128 sumr, sumi, difr, difi;
+        for (size_t p = 0; p < m; p++) {
+            const __m128 wr = _mm_set1_ps(h->TwiddleReal[p * 2 * s] * scale);
+            const __m128 wi = _mm_set1_ps(h->TwiddleImag[p * 2 * s] * imagScale);
+            const size_t a = s * p, b = s * (p + m), y = s * 2 * p;
+            for (size_t q = 0; q < s; q += 4) {
+                OrderedButterflySSE2(_mm_loadu_ps(xr + a + q), _mm_loadu_ps(xi + a + q),
+                    _mm_loadu_ps(xr + b + q), _mm_loadu_ps(xi + b + q), wr, wi, sc, sumr, sumi, difr, difi);
+                _mm_storeu_ps(yr + y + q, sumr);
+                _mm_storeu_ps(yi + y + q, sumi);
+                _mm_storeu_ps(yr + y + s + q, difr);
+                _mm_storeu_ps(yi + y + s + q, difi);
+            }
+        }
+    }
+
+    // s == 1: four twiddles per vector, every other entry of the table
+    FFT_TARGET_SSE2 void OrderedFirstPassSSE2(const FFTParam* h, size_t m, fft_type scale, fft_type imagScale,
+        const fft_type* xr, const fft_type* xi, fft_type* yr, fft_type* yi)
+    {
+        const __m128 sc = _mm_set1_ps(scale);
+        const __m128 isc = _mm_set1_ps(imagScale);
+        const fft_type* tr = h->TwiddleReal.get();
+        const fft_type* ti = h->TwiddleImag.get();
+        __m128 sumr, sumi, difr, difi;
+        for (size_t p = 0; p < m; p += 4) {
+            const __m128 wr = _mm_mul_ps(_mm_shuffle_ps(_mm_loadu_ps(tr + 2 * p), _mm_loadu_ps(tr + 2 * p + 4),
+                _MM_SHUFFLE(2, 0, 2, 0)), sc);
+            const __m128 wi = _mm_mul_ps(_mm_shuffle_ps(_mm_loadu_ps(ti + 2 * p), _mm_loadu_ps(ti + 2 * p + 4),
+                _MM_SHUFFLE(2, 0, 2, 0)), isc);
+            OrderedButterflySSE2(_mm_loadu_ps(xr + p), _mm_loadu_ps(xi + p),
+                _mm_loadu_ps(xr + p + m), _mm_loadu_ps(xi + p + m), wr, wi, sc, sumr, sumi, difr, difi);
+            _mm_storeu_ps(yr + 2 * p, _mm_unpacklo_ps(sumr, difr));
+            _mm_storeu_ps(yr + 2 * p + 4, _mm_unpackhi_ps(sumr, difr));
+            _mm_storeu_ps(yi + 2 * p, _mm_unpacklo_ps(sumi, difi));
+            _mm_storeu_ps(yi + 2 * p + 4, _mm_unpackhi_ps(sumi, difi));
+        }
+    }
+
+    // s == 2: two twiddles per vector, each used twice
+    FFT_TARGET_SSE2 void OrderedSecondPassSSE2(const FFTParam* h, size_t m, fft_type scale, fft_type imagScale,
+        const fft_type* xr, const fft_type* xi, fft_type* yr, fft_type* yi)
+    {
+        const __m128 sc = _mm_set1_ps(scale);
+        const __m128 isc = _mm_set1_ps(imagScale);
+        const fft_type* tr = h->TwiddleReal.get();
+        const fft_type* ti = h->TwiddleImag.get();
+        __m128 sumr, sumi, difr, difi;
+        for (size_t p = 0; p < m; p += 2) {
+            const __m128 wr = _mm_mul_ps(_mm_shuffle_ps(_mm_loadu_ps(tr + 4 * p), _mm_loadu_ps(tr + 4 * p + 4),
+                _MM_SHUFFLE(0, 0, 0, 0)), sc);
+            const __m128 wi = _mm_mul_ps(_mm_shuffle_ps(_mm_loadu_ps(ti + 4 * p), _mm_loadu_ps(ti + 4 * p + 4),
+                _MM_SHUFFLE(0, 0, 0, 0)), isc);
+            OrderedButterflySSE2(_mm_loadu_ps(xr + 2 * p), _mm_loadu_ps(xi + 2 * p),
+                _mm_loadu_ps(xr + 2 * (p + m)), _mm_loadu_ps(xi + 2 * (p + m)), wr, wi, sc, sumr, sumi, difr, difi);
+            _mm_storeu_ps(yr + 4 * p, _mm_movelh_ps(sumr, difr));
+            _mm_storeu_ps(yr + 4 * p + 4, _mm_movehl_ps(difr, sumr));
+            _mm_storeu_ps(yi + 4 * p, _mm_movelh_ps(sumi, difi));
+            _mm_storeu_ps(yi + 4 * p + 4, _mm_movehl_ps(difi, sumi));
+        }
+    }
+
+    FFT_TARGET_AVX2 void OrderedPassAVX2(const FFTParam* h, size_t m, size_t s, fft_type scale, fft_type imagScale,
+        const fft_type* xr, const fft_type* xi, fft_type* yr, fft_type* yi)
+    {
+        const __m256 sc = _mm256_set1_ps(scale);
+        for (size_t p = 0; p < m; p++) {
+            const __m256 wr = _mm256_set1_ps(h->TwiddleReal[p * 2 * s] * scale);
+            const __m256 wi = _mm256_set1_ps(h->TwiddleImag[p * 2 * s] * imagScale);
+            const size_t a = s * p, b = s * (p + m), y = s * 2 * p;
+            for (size_t q = 0; q < s; q += 8) {
+                const __m256 ar = _mm256_loadu_ps(xr + a + q), ai = _mm256_loadu_ps(xi + a + q);
+                const __m256 br = _mm256_loadu_ps(xr + b + q), bi = _mm256_loadu_ps(xi + b + q);
+                const __m256 dr = _mm256_sub_ps(ar, br);
+                const __m256 di = _mm256_sub_ps(ai, bi);
+                _mm256_storeu_ps(yr + y + q, _mm256_mul_ps(_mm256_add_ps(ar, br), sc));
+                _mm256_storeu_ps(yi + y + q, _mm256_mul_ps(_mm256_add_ps(ai, bi), sc));
+                _mm256_storeu_ps(yr + y + s + q, _mm256_sub_ps(_mm256_mul_ps(dr, wr), _mm256_mul_ps(di, wi)));
+                _mm256_storeu_ps(yi + y + s + q, _mm256_add_ps(_mm256_mul_ps(dr, wi), _mm256_mul_ps(di, wr)));
+            }
+        }
+        _mm256_zeroupper();
+    }
+
+    FFT_TARGET_AVX512 void OrderedPassAVX512(const FFTParam* h, size_t m, size_t s, fft_type scale, fft_type imagScale,
+        const fft_type* xr, const fft_type* xi, fft_type* yr, fft_type* yi)
+    {
+        const __m512 sc = _mm512_set1_ps(scale);
+        for (size_t p = 0; p < m; p++) {
+            const __m512 wr = _mm512_set1_ps(h->TwiddleReal[p * 2 * s] * scale);
+            const __m512 wi = _mm512_set1_ps(h->TwiddleImag[p * 2 * s] * imagScale);
+            const size_t a = s * p, b = s * (p + m), y = s * 2 * p;
+            for (size_t q = 0; q < s; q += 16) {
+                const __m512 ar = _mm512_loadu_ps(xr + a + q), ai = _mm512_loadu_ps(xi + a + q);
+                const __m512 br = _mm512_loadu_ps(xr + b + q), bi = _mm512_loadu_ps(xi + b + q);
+                const __m512 dr = _mm512_sub_ps(ar, br);
+                const __m512 di = _mm512_sub_ps(ai, bi);
+                _mm512_storeu_ps(yr + y + q, _mm512_mul_ps(_mm512_add_ps(ar, br), sc));
+                _mm512_storeu_ps(yi + y + q, _mm512_mul_ps(_mm512_add_ps(ai, bi), sc));
+                _mm512_storeu_ps(yr + y + s + q, _mm512_sub_ps(_mm512_mul_ps(dr, wr), _mm512_mul_ps(di, wi)));
+                _mm512_storeu_ps(yi + y + s + q, _mm512_add_ps(_mm512_mul_ps(dr, wi), _mm512_mul_ps(di, wr)));
+            }
+        }
+        _mm256_zeroupper();
+    }
+
+    /*
+    *  Split and pack pair bin k, running up, with bin Points - k, running
+    *  down, so the upper run is loaded and stored lane-reversed.  Both runs
+    *  of a chunk are read before either is written, which keeps the
+    *  in-place use safe.
+    */
+
+    FFT_TARGET_SSE2 inline __m128 ReverseSSE2(__m128 v)
+    {
+        return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+    }
+
+    FFT_TARGET_SSE2 size_t OrderedUnpackSSE2(const FFTParam* h, const fft_type* zr, const fft_type* zi,
+        fft_type* RealOut, fft_type* ImagOut, size_t k, size_t j)
+    {
+        const __m128 half = _mm_set1_ps(0.5f);
+        for (; j + 1 >= k + 8; k += 4, j -= 4) {
+            const __m128 akr = _mm_loadu_ps(zr + k), aki = _mm_loadu_ps(zi + k);
+            const __m128 ajr = ReverseSSE2(_mm_loadu_ps(zr + j - 3));
+            const __m128 aji = ReverseSSE2(_mm_loadu_ps(zi + j - 3));
+            const __m128 wr = _mm_loadu_ps(h->TwiddleReal.get() + k);
+            const __m128 wi = _mm_loadu_ps(h->TwiddleImag.get() + k);
+            const __m128 er = _mm_mul_ps(_mm_add_ps(akr, ajr), half);
+            const __m128 ei = _mm_mul_ps(_mm_sub_ps(aki, aji), half);
+            const __m128 or_ = _mm_mul_ps(_mm_add_ps(aki, aji), half);
+            const __m128 oi = _mm_mul_ps(_mm_sub_ps(ajr, akr), half);
+            const __m128 tr = _mm_sub_ps(_mm_mul_ps(wr, or_), _mm_mul_ps(wi, oi));
+            const __m128 ti = _mm_add_ps(_mm_mul_ps(wr, oi), _mm_mul_ps(wi, or_));
+            _mm_storeu_ps(RealOut + k, _mm_add_ps(er, tr));
+            _mm_storeu_ps(ImagOut + k, _mm_add_ps(ei, ti));
+            _mm_storeu_ps(RealOut + j - 3, ReverseSSE2(_mm_sub_ps(er, tr)));
+            _mm_storeu_ps(ImagOut + j - 3, ReverseSSE2(_mm_sub_ps(ti, ei)));
+        }
+        return k;
+    }
+
+    FFT_TARGET_SSE2 size_t OrderedPackSSE2(const FFTParam* h, const fft_type* RealIn, const fft_type* ImagIn,
+        fft_type* zr, fft_type* zi, size_t k, size_t j)
+    {
+        const __m128 half = _mm_set1_ps(0.5f);
+        for (; j + 1 >= k + 8; k += 4, j -= 4) {
+            const __m128 xkr = _mm_loadu_ps(RealIn + k), xki = _mm_loadu_ps(ImagIn + k);
+            const __m128 xjr = ReverseSSE2(_mm_loadu_ps(RealIn + j - 3));
+            const __m128 xji = ReverseSSE2(_mm_loadu_ps(ImagIn + j - 3));
+            const __m128 wr = _mm_loadu_ps(h->TwiddleReal.get() + k);
+            const __m128 wi = _mm_loadu_ps(h->TwiddleImag.get() + k);
+            const __m128 er = _mm_mul_ps(_mm_add_ps(xkr, xjr), half);
+            const __m128 ei = _mm_mul_ps(_mm_sub_ps(xki, xji), half);
+            const __m128 dr = _mm_mul_ps(_mm_sub_ps(xkr, xjr), half);
+            const __m128 di = _mm_mul_ps(_mm_add_ps(xki, xji), half);
+            const __m128 or_ = _mm_add_ps(_mm_mul_ps(wr, dr), _mm_mul_ps(wi, di));
+            const __m128 oi = _mm_sub_ps(_mm_mul_ps(wr, di), _mm_mul_ps(wi, dr));
+            _mm_storeu_ps(zr + k, _mm_sub_ps(er, oi));
+            _mm_storeu_ps(zi + k, _mm_add_ps(ei, or_));
+            _mm_storeu_ps(zr + j - 3, ReverseSSE2(_mm_add_ps(er, oi)));
+            _mm_storeu_ps(zi + j - 3, ReverseSSE2(_mm_sub_ps(or_, ei)));
+        }
+        return k;
+    }
+
+    FFT_TARGET_AVX2 inline __m256 ReverseAVX2(__m256 v)
+    {
+        return _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+    }
+
+    FFT_TARGET_AVX2 size_t OrderedUnpackAVX2(const FFTParam* h, const fft_type* zr, const fft_type* zi,
+        fft_type* RealOut, fft_type* ImagOut, size_t k, size_t j)
+    {
+        const __m256 half = _mm256_set1_ps(0.5f);
+        for (; j + 1 >= k + 16; k += 8, j -= 8) {
+            const __m256 akr = _mm256_loadu_ps(zr + k), aki = _mm256_loadu_ps(zi + k);
+            const __m256 ajr = ReverseAVX2(_mm256_loadu_ps(zr + j - 7));
+            const __m256 aji = ReverseAVX2(_mm256_loadu_ps(zi + j - 7));
+            const __m256 wr = _mm256_loadu_ps(h->TwiddleReal.get() + k);
+            const __m256 wi = _mm256_loadu_ps(h->TwiddleImag.get() + k);
+            const __m256 er = _mm256_mul_ps(_mm256_add_ps(akr, ajr), half);
+            const __m256 ei = _mm256_mul_ps(_mm256_sub_ps(aki, aji), half);
+            const __m256 or_ = _mm256_mul_ps(_mm256_add_ps(aki, aji), half);
+            const __m256 oi = _mm256_mul_ps(_mm256_sub_ps(ajr, akr), half);
+            const __m256 tr = _mm256_sub_ps(_mm256_mul_ps(wr, or_), _mm256_mul_ps(wi, oi));
+            const __m256 ti = _mm256_add_ps(_mm256_mul_ps(wr, oi), _mm256_mul_ps(wi, or_));
+            _mm256_storeu_ps(RealOut + k, _mm256_add_ps(er, tr));
+            _mm256_storeu_ps(ImagOut + k, _mm256_add_ps(ei, ti));
+            _mm256_storeu_ps(RealOut + j - 7, ReverseAVX2(_mm256_sub_ps(er, tr)));
+            _mm256_storeu_ps(ImagOut + j - 7, ReverseAVX2(_mm256_sub_ps(ti, ei)));
+        }
+        _mm256_zeroupper();
+        return k;
+    }
+
+    FFT_TARGET_AVX2 size_t OrderedPackAVX2(const FFTParam* h, const fft_type* RealIn, const fft_type* ImagIn,
+        fft_type* zr, fft_type* zi, size_t k, size_t j)
+    {
+        const __m256 half = _mm256_set1_ps(0.5f);
+        for (; j + 1 >= k + 16; k += 8, j -= 8) {
+            const __m256 xkr = _mm256_loadu_ps(RealIn + k), xki = _mm256_loadu_ps(ImagIn + k);
+            const __m256 xjr = ReverseAVX2(_mm256_loadu_ps(RealIn + j - 7));
+            const __m256 xji = ReverseAVX2(_mm256_loadu_ps(ImagIn + j - 7));
+            const __m256 wr = _mm256_loadu_ps(h->TwiddleReal.get() + k);
+            const __m256 wi = _mm256_loadu_ps(h->TwiddleImag.get() + k);
+            const __m256 er = _mm256_mul_ps(_mm256_add_ps(xkr, xjr), half);
+            const __m256 ei = _mm256_mul_ps(_mm256_sub_ps(xki, xji), half);
+            const __m256 dr = _mm256_mul_ps(_mm256_sub_ps(xkr, xjr), half);
+            const __m256 di = _mm256_mul_ps(_mm256_add_ps(xki, xji), half);
+            const __m256 or_ = _mm256_add_ps(_mm256_mul_ps(wr, dr), _mm256_mul_ps(wi, di));
+            const __m256 oi = _mm256_sub_ps(_mm256_mul_ps(wr, di), _mm256_mul_ps(wi, dr));
+            _mm256_storeu_ps(zr + k, _mm256_sub_ps(er, oi));
+            _mm256_storeu_ps(zi + k, _mm256_add_ps(ei, or_));
+            _mm256_storeu_ps(zr + j - 7, ReverseAVX2(_mm256_add_ps(er, oi)));
+            _mm256_storeu_ps(zi + j - 7, ReverseAVX2(_mm256_sub_ps(or_, ei)));
+        }
+        _mm256_zeroupper();
+        return k;
+    }
+
+    FFT_TARGET_SSE2 size_t SplitSSE2(const fft_type* buffer, fft_type* even, fft_type* odd, size_t i, size_t count)
+    {
+        for (; i + 4 <= count; i += 4) {
+            const __m128 v0 = _mm_loadu_ps(buffer + 2 * i);
+            const __m128 v1 = _mm_loadu_ps(buffer + 2 * i + 4);
+            _mm_storeu_ps(even + i, _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(odd + i, _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+        return i;
+    }
+
+    FFT_TARGET_SSE2 size_t MergeSSE2(const fft_type* even, const fft_type* odd, fft_type* buffer, size_t i, size_t count)
+    {
+        for (; i + 4 <= count; i += 4) {
+            const __m128 e = _mm_loadu_ps(even + i);
+            const __m128 o = _mm_loadu_ps(odd + i);
+            _mm_storeu_ps(buffer + 2 * i, _mm_unpacklo_ps(e, o));
+            _mm_storeu_ps(buffer + 2 * i + 4, _mm_unpackhi_ps(e, o));
+        }
+        return i;
+    }
+
+    FFT_TARGET_AVX2 size_t SplitAVX2(const fft_type* buffer, fft_type* even, fft_type* odd, size_t i, size_t count)
+    {
+        for (; i + 8 <= count; i += 8) {
+            // The shuffles work per 128-bit lane, the 64-bit permute puts the halves in order
+            const __m256 v0 = _mm256_loadu_ps(buffer + 2 * i);
+            const __m256 v1 = _mm256_loadu_ps(buffer + 2 * i + 8);
+            const __m256d e = _mm256_castps_pd(_mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)));
+            const __m256d o = _mm256_castps_pd(_mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+            _mm256_storeu_ps(even + i, _mm256_castpd_ps(_mm256_permute4x64_pd(e, _MM_SHUFFLE(3, 1, 2, 0))));
+            _mm256_storeu_ps(odd + i, _mm256_castpd_ps(_mm256_permute4x64_pd(o, _MM_SHUFFLE(3, 1, 2, 0))));
+        }
+        _mm256_zeroupper();
+        return i;
+    }
+
+    FFT_TARGET_AVX2 size_t MergeAVX2(const fft_type* even, const fft_type* odd, fft_type* buffer, size_t i, size_t count)
+    {
+        for (; i + 8 <= count; i += 8) {
+            const __m256 e = _mm256_loadu_ps(even + i);
+            const __m256 o = _mm256_loadu_ps(odd + i);
+            const __m256 lo = _mm256_unpacklo_ps(e, o);
+            const __m256 hi = _mm256_unpackhi_ps(e, o);
+            _mm256_storeu_ps(buffer + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+            _mm256_storeu_ps(buffer + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+        }
+        _mm256_zeroupper();
+        return i;
+    }
+
+    /* ------------------------------------------------------------- dispatch */
+
+    template<bool Inverse>
+    bool Butterflies(FFTKernel kernel, fft_type* buffer, const FFTParam* h, size_t butterfliesPerGroup)
+    {
+        const fft_type* sinTable = h->SinTable.get();
+        if (kernel >= FFTKernel::AVX512 && butterfliesPerGroup >= 8)
+            PassAVX512<Inverse>(buffer, sinTable, h->Points, butterfliesPerGroup);
+        else if (kernel >= FFTKernel::AVX2 && butterfliesPerGroup >= 4)
+            PassAVX2<Inverse>(buffer, sinTable, h->Points, butterfliesPerGroup);
+        else if (kernel >= FFTKernel::SSE2 && butterfliesPerGroup >= 2)
+            PassSSE2<Inverse>(buffer, sinTable, h->Points, butterfliesPerGroup);
+        else if (kernel >= FFTKernel::SSE2 && butterfliesPerGroup == 1 && h->Points % 4 == 0)
+            PairPassSSE2<Inverse>(buffer, sinTable, h->Points);
+        else
+            return false;
+        return true;
+    }
+
+    void Cpuid(int info[4], int leaf, int subleaf)
+    {
+#if defined(_MSC_VER)
+        __cpuidex(info, leaf, subleaf);
+#else
+        unsigned a, b, c, d;
+        __cpuid_count(leaf, subleaf, a, b, c, d);
+        info[0] = (int)a; info[1] = (int)b; info[2] = (int)c; info[3] = (int)d;
+#endif
+    }
+
+    // Register state the OS saves on context switches
+    uint64_t ReadXcr0()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        unsigned lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return ((uint64_t)hi << 32) | lo;
+#endif
+    }
+}
+
+bool ForwardButterfliesSimd(FFTKernel kernel, fft_type* buffer, const FFTParam* h,
+    size_t butterfliesPerGroup)
+{
+    return Butterflies<false>(kernel, buffer, h, butterfliesPerGroup);
+}
+
+bool InverseButterfliesSimd(FFTKernel kernel, fft_type* buffer, const FFTParam* h,
+    size_t butterfliesPerGroup)
+{
+    return Butterflies<true>(kernel, buffer, h, butterfliesPerGroup);
+}
+
+size_t ForwardUnpackSimd(FFTKernel kernel, fft_type* buffer, const FFTParam* h)
+{
+    size_t i = 1;
+    const size_t end = h->Points / 2;
+    if (kernel >= FFTKernel::AVX512)
+        i = ForwardUnpackAVX512(buffer, h, i, end);
+    if (kernel >= FFTKernel::AVX2)
+        i = ForwardUnpackAVX2(buffer, h, i, end);
+    if (kernel >= FFTKernel::SSE2)
+        i = ForwardUnpackSSE2(buffer, h, i, end);
+    return i - 1;
+}
+
+size_t InversePackSimd(FFTKernel kernel, fft_type* buffer, const FFTParam* h)
+{
+    size_t i = 1;
+    const size_t end = h->Points / 2;
+    if (kernel >= FFTKernel::AVX512)
+        i = InversePackAVX512(buffer, h, i, end);
+    if (kernel >= FFTKernel::AVX2)
+        i = InversePackAVX2(buffer, h, i, end);
+    if (kernel >= FFTKernel::SSE2)
+        i = InversePackSSE2(buffer, h, i, end);
+    return i - 1;
+}
+
+bool OrderedPassSimd(FFTKernel kernel, const FFTParam* h, size_t m, size_t s,
+    fft_type scale, fft_type imagScale,
+    const fft_type* xr, const fft_type* xi, fft_type* yr, fft_type* yi)
+{
+    if (kernel >= FFTKernel::AVX512 && s >= 16)
+        OrderedPassAVX512(h, m, s, scale, imagScale, xr, xi, yr, yi);
+    else if (kernel >= FFTKernel::AVX2 && s >= 8)
+        OrderedPassAVX2(h, m, s, scale, imagScale, xr, xi, yr, yi);
+    else if (kernel >= FFTKernel::SSE2 && s >= 4)
+        OrderedPassSSE2(h, m, s, scale, imagScale, xr, xi, yr, yi);
+    else if (kernel >= FFTKernel::SSE2 && s == 1 && m % 4 == 0)
+        OrderedFirstPassSSE2(h, m, scale, imagScale, xr, xi, yr, yi);
+    else if (kernel >= FFTKernel::SSE2 && s == 2 && m % 2 == 0)
+        OrderedSecondPassSSE2(h, m, scale, imagScale, xr, xi, yr, yi);
+    else
+        return false;
+    return true;
+}
+
+size_t OrderedUnpackSimd(FFTKernel kernel, const FFTParam* h,
+    const fft_type* zr, const fft_type* zi, fft_type* RealOut, fft_type* ImagOut)
+{
+    size_t k = 1;
+    const size_t last = h->Points - 1;
+    if (kernel >= FFTKernel::AVX2)
+        k = OrderedUnpackAVX2(h, zr, zi, RealOut, ImagOut, k, last + 1 - k);
+    if (kernel >= FFTKernel::SSE2)
+        k = OrderedUnpackSSE2(h, zr, zi, RealOut, ImagOut, k, last + 1 - k);
+    return k - 1;
+}
+
+size_t OrderedPackSimd(FFTKernel kernel, const FFTParam* h,
+    const fft_type* RealIn, const fft_type* ImagIn, fft_type* zr, fft_type* zi)
+{
+    size_t k = 1;
+    const size_t last = h->Points - 1;
+    if (kernel >= FFTKernel::AVX2)
+        k = OrderedPackAVX2(h, RealIn, ImagIn, zr, zi, k, last + 1 - k);
+    if (kernel >= FFTKernel::SSE2)
+        k = OrderedPackSSE2(h, RealIn, ImagIn, zr, zi, k, last + 1 - k);
+    return k - 1;
+}
+
+size_t SplitSimd(FFTKernel kernel, const fft_type* buffer, fft_type* even, fft_type* odd, size_t count)
+{
+    size_t i = 0;
+    if (kernel >= FFTKernel::AVX2)
+        i = SplitAVX2(buffer, even, odd, i, count);
+    if (kernel >= FFTKernel::SSE2)
+        i = SplitSSE2(buffer, even, odd, i, count);
+    return i;
+}
+
+size_t MergeSimd(FFTKernel kernel, const fft_type* even, const fft_type* odd, fft_type* buffer, size_t count)
+{
+    size_t i = 0;
+    if (kernel >= FFTKernel::AVX2)
+        i = MergeAVX2(even, odd, buffer, i, count);
+    if (kernel >= FFTKernel::SSE2)
+        i = MergeSSE2(even, odd, buffer, i, count);
+    return i;
+}
+
+FFTKernel DetectFFTKernel()
+{
+    int info[4];
+    Cpuid(info, 0, 0);
+    const int maxLeaf = info[0];
+
+    Cpuid(info, 1, 0);
+    const bool sse2 = (info[3] >> 26) & 1;
+    const bool osxsave = (info[2] >> 27) & 1;
+    const bool avx = (info[2] >> 28) & 1;
+
+    bool avx2 = false, avx512 = false;
+    if (maxLeaf >= 7) {
+        Cpuid(info, 7, 0);
+        avx2 = (info[1] >> 5) & 1;
+        avx512 = (info[1] >> 16) & 1;
+    }
+
+    // The OS must save the YMM (and for AVX-512 the opmask and ZMM) registers
+    const uint64_t xcr0 = osxsave ? ReadXcr0() : 0;
+    const bool ymmState = (xcr0 & 0x06) == 0x06;
+    const bool zmmState = (xcr0 & 0xE6) == 0xE6;
+
+    if (avx && avx2 && avx512 && zmmState)
+        return FFTKernel::AVX512;
+    if (avx && avx2 && ymmState)
+        return FFTKernel::AVX2;
+    if (sse2)
+        return FFTKernel::SSE2;
+    return FFTKernel::Scalar;
+}
+
+#else
+
+// Other architectures run the scalar code only
+
+bool ForwardButterfliesSimd(FFTKernel, fft_type*, const FFTParam*, size_t) { return false; }
+bool InverseButterfliesSimd(FFTKernel, fft_type*, const FFTParam*, size_t) { return false; }
+size_t ForwardUnpackSimd(FFTKernel, fft_type*, const FFTParam*) { return 0; }
+size_t InversePackSimd(FFTKernel, fft_type*, const FFTParam*) { return 0; }
+bool OrderedPassSimd(FFTKernel, const FFTParam*, size_t, size_t, fft_type, fft_type,
+    const fft_type*, const fft_type*, fft_type*, fft_type*) { return false; }
+size_t OrderedUnpackSimd(FFTKernel, const FFTParam*, const fft_type*, const fft_type*, fft_type*, fft_type*) { return 0; }
+size_t OrderedPackSimd(FFTKernel, const FFTParam*, const fft_type*, const fft_type*, fft_type*, fft_type*) { return 0; }
+size_t SplitSimd(FFTKernel, const fft_type*, fft_type*, fft_type*, size_t) { return 0; }
+size_t MergeSimd(FFTKernel, const fft_type*, const fft_type*, fft_type*, size_t) { return 0; }
+FFTKernel DetectFFTKernel() { return FFTKernel::Scalar; }
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef __realfftfsimd_h
+#define __realfftfsimd_h
+
+/*
+*  SIMD pieces of RealFFTf and InverseRealFFTf, used only by RealFFTf.cpp.
+*
+*  Each routine does as much of one stage as its kernel allows and tells the
+*  caller what is left, so the scalar code in RealFFTf.cpp stays the reference
+*  and finishes small sizes and remainders.  The arithmetic is the scalar
+*  arithmetic lane for lane (no FMA contraction, same operation order), so all
+*  kernels give bit-identical output.
+*/
+
+#include "RealFFTf.h"
+
+// One butterfly pass; false when the kernel does not apply to this group size
+bool ForwardButterfliesSimd(FFTKernel kernel, fft_type* buffer, const FFTParam* h,
+    size_t butterfliesPerGroup);
+bool InverseButterfliesSimd(FFTKernel kernel, fft_type* buffer, const FFTParam* h,
+    size_t butterfliesPerGroup);
+
+// Real-sequence post-processing of the forward FFT, from bin pair 1 upwards.
+// Returns the number of bin pairs done.
+size_t ForwardUnpackSimd(FFTKernel kernel, fft_type* buffer, const FFTParam* h);
+
+// Real-sequence pre-processing of the inverse FFT, from bin pair 1 upwards.
+// Returns the number of bin pairs done.
+size_t InversePackSimd(FFTKernel kernel, fft_type* buffer, const FFTParam* h);
+
+// Ordered variants: one Stockham pass (see OrderedPass in RealFFTf.cpp) with
+// the twiddles scaled by scale and imagScale; false when no kernel applies
+bool OrderedPassSimd(FFTKernel kernel, const FFTParam* h, size_t m, size_t s,
+    fft_type scale, fft_type imagScale,
+    const fft_type* xr, const fft_type* xi, fft_type* yr, fft_type* yi);
+
+// Ordered variants: split Z into the spectrum of the real sequence, and back,
+// from bin pair (1, Points - 1) inwards.  Returns the number of pairs done.
+size_t OrderedUnpackSimd(FFTKernel kernel, const FFTParam* h,
+    const fft_type* zr, const fft_type* zi, fft_type* RealOut, fft_type* ImagOut);
+size_t OrderedPackSimd(FFTKernel kernel, const FFTParam* h,
+    const fft_type* RealIn, const fft_type* ImagIn, fft_type* zr, fft_type* zi);
+
+// Interleaved (even, odd) samples to separate arrays and back.
+// Returns the number of sample pairs done.
+size_t SplitSimd(FFTKernel kernel, const fft_type* buffer, fft_type* even, fft_type* odd, size_t count);
+size_t MergeSimd(FFTKernel kernel, const fft_type* even, const fft_type* odd, fft_type* buffer, size_t count);
+
+// Widest kernel the CPU and the operating system support
+FFTKernel DetectFFTKernel();
+
+#endif
@@ -0,0 +1,249 @@
+#define _USE_MATH_DEFINES
+
+#include "Resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string.h>
+
+#include "RealFFTf.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RESAMPLER_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define RESAMPLER_X86_KERNELS 0
+#endif
+
+// As in RealFFTfSimd.cpp: GCC and Clang want the target per function
+#if RESAMPLER_X86_KERNELS
+#if defined(_MSC_VER) && !defined(__clang__)
+#define RESAMPLER_TARGET_SSE2
+#define RESAMPLER_TARGET_AVX2
+#else
+#define RESAMPLER_TARGET_SSE2 __attribute__((target("sse2")))
+#define RESAMPLER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+	struct QualityInfo
+	{
+		const char* name;
+		size_t taps;      // per phase, a multiple of 8
+		double beta;      // Kaiser window shape
+		double rolloff;   // cutoff, 6 dB down, as a fraction of the lower Nyquist frequency
+	};
+
+	// Taps at 1:1, more when downsampling; see Resampler.h for the response
+	const QualityInfo qualityInfo[] = {
+		{ "fast", 16, 5.0, 0.80 },
+		{ "balanced", 32, 8.0, 0.90 },
+		{ "best", 64, 10.5, 0.94 },
+	};
+
+	// Zeroth order modified Bessel function of the first kind
+	double BesselI0(double x)
+	{
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 50 && term > 1e-12 * sum; ++k)
+		{
+			const double half = x / (2.0 * k);
+			term *= half * half;
+			sum += term;
+		}
+		return sum;
+	}
+
+	float DotScalar(const float* a, const float* b, size_t count)
+	{
+		float sum = 0.0f;
+		for (size_t ii = 0; ii < count; ++ii)
+			sum += a[ii] * b[ii];
+		return sum;
+	}
+
+#if RESAMPLER_X86_KERNELS
+	RESAMPLER_TARGET_SSE2
+	float DotSSE2(const float* a, const float* b, size_t count)
+	{
+		__m128 sum0 = _mm_setzero_ps();
+		__m128 sum1 = _mm_setzero_ps();
+		for (size_t ii = 0; ii < count; ii += 8)
+		{
+			sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + ii), _mm_loadu_ps(b + ii)));
+			sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + ii + 4), _mm_loadu_ps(b + ii + 4)));
+		}
+		__m128 sum = _mm_add_ps(sum0, sum1);
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+		return _mm_cvtss_f32(sum);
+	}
+
+	RESAMPLER_TARGET_AVX2
+	float DotAVX2(const float* a, const float* b, size_t count)
+	{
+		__m256 sum0 = _mm256_setzero_ps();
+		__m256 sum1 = _mm256_setzero_ps();
+		size_t ii = 0;
+		for (; ii + 16 <= count; ii += 16)
+		{
+			sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(a + ii), _mm256_loadu_ps(b + ii)));
+			sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(a + ii + 8), _mm256_loadu_ps(b + ii + 8)));
+		}
+		if (ii < count)
+			sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(a + ii), _mm256_loadu_ps(b + ii)));
+		const __m256 sum8 = _mm256_add_ps(sum0, sum1);
+		__m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum8), _mm256_extractf128_ps(sum8, 1));
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+		return _mm_cvtss_f32(sum);
+	}
+#endif
+
+	typedef float (*DotFunction)(const float*, const float*, size_t);
+
+	DotFunction SelectDot()
+	{
+#if RESAMPLER_X86_KERNELS
+		const FFTKernel kernel = GetFFTKernel();
+		if (kernel >= FFTKernel::AVX2)
+			return DotAVX2;
+		if (kernel >= FFTKernel::SSE2)
+			return DotSSE2;
+#endif
+		return DotScalar;
+	}
+}
+
+const char* ResamplerQualityName(ResamplerQuality quality)
+{
+	return qualityInfo[(int)quality].name;
+}
+
+const char* ResamplerKernelName()
+{
+#if RESAMPLER_X86_KERNELS
+	const DotFunction dot = SelectDot();
+	if (dot == DotAVX2)
+		return "AVX2";
+	if (dot == DotSSE2)
+		return "SSE2";
+#endif
+	return "scalar";
+}
+
+Resampler::Resampler(double inRate, double outRate, size_t channels, ResamplerQuality quality)
+	: mInRate(inRate)
+	, mOutRate(outRate)
+	, mChannels(channels)
+	, mTime(0)
+{
+	const long long in = std::llround(inRate);
+	const long long out = std::llround(outRate);
+	if (in <= 0 || out <= 0 || in != inRate || out != outRate || channels == 0)
+		throw std::invalid_argument("Resampler rates must be whole numbers of Hz.");
+
+	const long long divisor = std::gcd(in, out);
+	mUp = (size_t)(out / divisor);
+	mDown = (size_t)(in / divisor);
+	if (mUp > MAX_PHASES)
+		throw std::invalid_argument("Resampler rates are too far from a simple ratio.");
+
+	// The cutoff is at the lower Nyquist frequency, so when downsampling
+	// the filter must reach as many output periods back as it would at 1:1:
+	// M / L times the taps, rounded up to a multiple of 8 for the kernels
+	const QualityInfo& info = qualityInfo[(int)quality];
+	mTaps = (info.taps * std::max(mUp, mDown) + mUp - 1) / mUp;
+	mTaps = (mTaps + 7) / 8 * 8;
+
+	// The prototype filter runs at the upsampled rate; it passes up to the
+	// lower of the two Nyquist frequencies, with the gain of L that makes
+	// up for the zeros the upsampling puts between the samples
+	const size_t length = mUp * mTaps;
+	const double center = (length - 1) / 2.0;
+	const double cutoff = info.rolloff * 0.5 / std::max(mUp, mDown);
+	const double norm = BesselI0(info.beta);
+
+	// The sinc peaks on a whole output frame, so the delay is exact; the
+	// window stays centred, the shift is small against its length
+	mLatency = (size_t)std::lround(center / mDown);
+	const double delay = (double)(mLatency * mDown);
+
+	mCoefficients.resize(length);
+	for (size_t ii = 0; ii < length; ++ii)
+	{
+		const double x = ii - delay;
+		const double arg = 2.0 * cutoff * x;
+		const double sinc = x == 0.0 ? 1.0 : sin(M_PI * arg) / (M_PI * arg);
+		const double ratio = (ii - center) / (center + 0.5);
+		const double window = BesselI0(info.beta * sqrt(std::max(0.0, 1.0 - ratio * ratio))) / norm;
+		const double tap = 2.0 * cutoff * mUp * sinc * window;
+
+		// Tap ii belongs to phase ii % L, and weighs the input ii / L
+		// samples back from the newest
+		const size_t phase = ii % mUp;
+		const size_t back = ii / mUp;
+		mCoefficients[phase * mTaps + (mTaps - 1 - back)] = (float)tap;
+	}
+
+	mStride = mTaps - 1 + CHUNK_FRAMES;
+	mHistory.assign(mStride * mChannels, 0.0f);
+}
+
+void Resampler::Reset()
+{
+	std::fill(mHistory.begin(), mHistory.end(), 0.0f);
+	mTime = 0;
+}
+
+size_t Resampler::Process(const float* input, size_t frames, float* output)
+{
+	const DotFunction dot = SelectDot();
+	const size_t history = mTaps - 1;
+	size_t produced = 0;
+
+	while (frames > 0)
+	{
+		const size_t chunk = std::min(frames, CHUNK_FRAMES);
+
+		for (size_t cc = 0; cc < mChannels; ++cc)
+		{
+			float* pHistory = &mHistory[cc * mStride + history];
+			for (size_t ii = 0; ii < chunk; ++ii)
+				pHistory[ii] = input[ii * mChannels + cc];
+		}
+
+		// Every output whose newest input sample is in this chunk; output
+		// t on the upsampled grid is phase t % L of input t / L
+		const size_t end = chunk * mUp;
+		for (; mTime < end; mTime += mDown, ++produced)
+		{
+			const size_t newest = mTime / mUp;
+			const float* coefficients = &mCoefficients[(mTime % mUp) * mTaps];
+			for (size_t cc = 0; cc < mChannels; ++cc)
+				output[produced * mChannels + cc] = dot(coefficients, &mHistory[cc * mStride + newest], mTaps);
+		}
+		mTime -= end;
+
+		for (size_t cc = 0; cc < mChannels; ++cc)
+		{
+			float* pHistory = &mHistory[cc * mStride];
+			memmove(pHistory, pHistory + chunk, history * sizeof(float));
+		}
+
+		input += chunk * mChannels;
+		frames -= chunk;
+	}
+
+	return produced;
+}
+
+size_t Resampler::Flush(float* output)
+{
+	const std::vector<float> silence(mTaps * mChannels, 0.0f);
+	return Process(silence.data(), mTaps, output);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Filter length against quality: Fast keeps the delay short for the live
+// stream, Best is for offline work such as noise profiles.  At any ratio,
+// aliases and images below the cutoff are at least 57, 83 and 104 dB down,
+// and the response is within 0.1 dB up to 0.6, 0.77 and 0.87 of the lower
+// Nyquist frequency.
+enum class ResamplerQuality { Fast, Balanced, Best };
+
+const char* ResamplerQualityName(ResamplerQuality quality);
+
+// The dot product kernel Process runs on, "scalar", "SSE2" or "AVX2"
+const char* ResamplerKernelName();
+
+// Sample rate conversion by a rational factor, outRate / inRate reduced to
+// L / M, with a polyphase Kaiser-windowed sinc filter: every output sample is
+// one dot product of a filter phase with the latest taps input samples of
+// its channel.  The dot products run on the widest instruction set the FFT
+// kernel in use allows (see GetFFTKernel), so --kernel narrows them too.
+// Streaming: state carries over between Process calls, which take any
+// number of interleaved frames and never allocate.
+class Resampler
+{
+public:
+	// Rates are whole numbers of Hz, and L must not pass MAX_PHASES;
+	// throws std::invalid_argument otherwise
+	Resampler(double inRate, double outRate, size_t channels, ResamplerQuality quality = ResamplerQuality::Balanced);
+
+	static constexpr size_t MAX_PHASES = 1024;
+
+	// Frames of input taken per pass through the channel histories
+	static constexpr size_t CHUNK_FRAMES = 1024;
+
+	// Interleaved frames in and out; output must have room for
+	// MaxOutput(frames) frames.  Returns the frames written.
+	size_t Process(const float* input, size_t frames, float* output);
+
+	// The output still owed for the input so far, made by running the
+	// filter over silence.  Returns the frames written, at most MaxOutput(Taps()).
+	size_t Flush(float* output);
+
+	void Reset();
+
+	size_t MaxOutput(size_t frames) const { return (frames * mUp + mDown - 1) / mDown + 1; }
+
+	// Delay of the filter, in output frames
+	size_t Latency() const { return mLatency; }
+
+	size_t Taps() const { return mTaps; }
+	size_t Channels() const { return mChannels; }
+	double InRate() const { return mInRate; }
+	double OutRate() const { return mOutRate; }
+
+private:
+	const double mInRate;
+	const double mOutRate;
+	const size_t mChannels;
+	size_t mUp;
+	size_t mDown;
+	size_t mTaps;
+	size_t mLatency;
+
+	// Taps of each phase in turn, reversed, so a phase runs forwards over
+	// the history in time order
+	std::vector<float> mCoefficients;
+
+	// Per channel, mTaps - 1 samples of history and then a chunk of input
+	std::vector<float> mHistory;
+	size_t mStride;
+
+	// Position of the next output on the upsampled grid, counted from the
+	// first sample of the current chunk
+	size_t mTime;
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <string.h>
+
+#include "Types.h"
+
+// Wait-free single-producer/single-consumer ring of interleaved float frames.
+// One thread calls the Write* functions, one other thread the Read*
+// functions; neither side ever blocks, locks or retries.  Write drops the
+// frames that do not fit and Read zero-fills the frames that are missing,
+// each counting the event, so both sides keep their real-time cadence.
+class FrameRingBuffer
+{
+public:
+    static constexpr size_t CacheLineSize = 64;
+
+    FrameRingBuffer(size_t capacityFrames, size_t channels)
+        : mChannels(channels)
+    {
+        // Power of two capacity so positions are a mask of the counters
+        mCapacity = 1;
+        while (mCapacity < capacityFrames)
+            mCapacity <<= 1;
+        mMask = mCapacity - 1;
+        mBuffer.assign(mCapacity * mChannels, 0.0f);
+    }
+
+    size_t Capacity() const { return mCapacity; }
+    size_t Channels() const { return mChannels; }
+
+    // Producer side
+
+    size_t WriteAvailable() const
+    {
+        return mCapacity - (mProducer.index.load(std::memory_order_relaxed)
+            - mConsumer.index.load(std::memory_order_acquire));
+    }
+
+    size_t Write(const float* frames, size_t count)
+    {
+        const size_t write = mProducer.index.load(std::memory_order_relaxed);
+        const size_t n = std::min(count, SpaceFor(write));
+        if (n < count)
+            mProducer.events.fetch_add(1, std::memory_order_relaxed);
+
+        Copy(&mBuffer[0], write, frames, n);
+        mProducer.index.store(write + n, std::memory_order_release);
+        return n;
+    }
+
+    size_t WriteSilence(size_t count)
+    {
+        const size_t write = mProducer.index.load(std::memory_order_relaxed);
+        const size_t n = std::min(count, SpaceFor(write));
+
+        for (size_t ii = 0; ii < n; ++ii) {
+            float* frame = &mBuffer[((write + ii) & mMask) * mChannels];
+            std::fill(frame, frame + mChannels, 0.0f);
+        }
+        mProducer.index.store(write + n, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer side
+
+    size_t ReadAvailable() const
+    {
+        return mProducer.index.load(std::memory_order_acquire)
+            - mConsumer.index.load(std::memory_order_relaxed);
+    }
+
+    size_t Read(float* frames, size_t count)
+    {
+        const size_t read = mConsumer.index.load(std::memory_order_relaxed);
+        const size_t n = std::min(count, mProducer.index.load(std::memory_order_acquire) - read);
+        if (n < count) {
+            mConsumer.events.fetch_add(1, std::memory_order_relaxed);
+            std::fill(frames + n * mChannels, frames + count * mChannels, 0.0f);
+        }
+
+        Copy(frames, read, n);
+        mConsumer.index.store(read + n, std::memory_order_release);
+        return n;
+    }
+
+    // Statistics, safe to read from any thread
+
+    // Number of Write calls that had to drop frames
+    uint64_t Overruns() const { return mProducer.events.load(std::memory_order_relaxed); }
+    // Number of Read calls that had to zero-fill frames
+    uint64_t Underruns() const { return mConsumer.events.load(std::memory_order_relaxed); }
+
+private:
+    size_t SpaceFor(size_t write) const
+    {
+        return mCapacity - (write - mConsumer.index.load(std::memory_order_acquire));
+    }
+
+    // Into the ring, in at most two pieces around the wrap
+    void Copy(float* ring, size_t position, const float* frames, size_t count)
+    {
+        const size_t start = position & mMask;
+        const size_t first = std::min(count, mCapacity - start);
+        memcpy(ring + start * mChannels, frames, first * mChannels * sizeof(float));
+        memcpy(ring, frames + first * mChannels, (count - first) * mChannels * sizeof(float));
+    }
+
+    // Out of the ring
+    void Copy(float* frames, size_t position, size_t count) const
+    {
+        const size_t start = position & mMask;
+        const size_t first = std::min(count, mCapacity - start);
+        memcpy(frames, &mBuffer[start * mChannels], first * mChannels * sizeof(float));
+        memcpy(frames + first * mChannels, &mBuffer[0], (count - first) * mChannels * sizeof(float));
+    }
+
+    // Each side owns one cache line: its counter and its event count
+    struct alignas(CacheLineSize) Side
+    {
+        std::atomic<size_t> index{ 0 };
+        std::atomic<uint64_t> events{ 0 };
+    };
+
+    Side mProducer;
+    Side mConsumer;
+
+    size_t mCapacity;
+    size_t mMask;
+    const size_t mChannels;
+    FloatVector mBuffer;
+};
@@ -4,7 +4,7 @@ void SoundWindow::createAppOptionsWindow(int display_w)
 {
     ImGuiWindowFlags windowFlags = ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove;
 
-    ImGui::SetNextWindowSize(ImVec2((float)display_w, 180.0f));
+    ImGui::SetNextWindowSize(ImVec2((float)display_w, 300.0f));
     ImGui::SetNextWindowPos(ImVec2(0.f, 450.0f));
 
     ImGui::Begin("App Options", nullptr, windowFlags);
@@ -46,6 +46,22 @@ void SoundWindow::createAppOptionsWindow(int display_w)
     ImGui::InputInt("Chunk", &mChunkSize);
     ImGui::InputFloat("ThreshholdDB", &mSilenceThresholdDB);
 
+    ImGui::Combo("Block", &mBlockSizeChoice, "64\0" "128\0" "256\0" "512\0" "1024\0" "2048\0" "4096\0");
+    ImGui::Combo("Window", &mWindowSizeChoice, "512\0" "1024\0" "2048\0" "4096\0");
+    ImGui::Combo("Resampler", &mResamplerChoice, "Fast\0" "Balanced\0" "Best\0");
+
+    ImGui::Checkbox("Link channels", &mLinkChannels);
+    ImGui::SameLine();
+    ImGui::Checkbox("Parallel channels", &mParallelChannels);
+
+    ImGui::Checkbox("Adaptive noise floor", &mAdaptiveNoise);
+    ImGui::SameLine();
+    ImGui::SliderFloat("Adaptive weight", &mAdaptiveWeight, 0.0f, 1.0f);
+
+    ImGui::Text("Latency: %zu samples (%.1f ms)", latencySamples, latencyMs);
+    ImGui::Text("Device: %.0f Hz%s", deviceRate, resampling ? ", converted to 48000 Hz" : "");
+    ImGui::Text("FFT: %s, %zu plans (%llu hits, %llu misses)", fftKernel, fftPlans, fftPlanHits, fftPlanMisses);
+
     ImGui::End();
 }
 
@@ -149,6 +165,16 @@ void SoundWindow::drawNeedle() {
 
     ImGui::LabelText("degrees", std::to_string(noiceAngle).c_str());
 
+    ImGui::ProgressBar(std::min(leftLevel, 1.0f), ImVec2(120, 0), "L");
+    ImGui::SameLine();
+    ImGui::ProgressBar(std::min(rightLevel, 1.0f), ImVec2(120, 0), "R");
+
+    ImGui::Text("Overruns: %llu  Underruns: %llu", overruns, underruns);
+
+#ifdef _DEBUG
+    ImGui::Text("Hot path allocations: %llu", hotPathAllocations);
+#endif
+
     float needleX = centerX + needleLength * sin(radians);
     float needleY = centerY - needleLength * cos(radians);
 
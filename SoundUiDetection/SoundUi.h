@@ -22,7 +22,7 @@ public:
         if (!glfwInit())
             throw std::runtime_error("Failed to initialize GLFW");
 
-        window = glfwCreateWindow(600, 700, "Needle", NULL, NULL);
+        window = glfwCreateWindow(600, 750, "Needle", NULL, NULL);
 
         glfwMakeContextCurrent(window);
         glfwSwapInterval(1);
@@ -69,8 +69,47 @@ public:
     float mFreqSmoothingBands = 6.0f;
     float mNoiseGain = 13.f;
     float noiceAngle = 0.0f;
+    float leftLevel = 0.0f;
+    float rightLevel = 0.0f;
+    unsigned long long overruns = 0;
+    unsigned long long underruns = 0;
+    unsigned long long hotPathAllocations = 0;
 
     int mChunkSize = 512;
+
+    // Same gain in both channels keeps the level difference the needle reads
+    bool mLinkChannels = true;
+    bool mParallelChannels = false;
+
+    // Noise floor tracked from the game audio, mixed into the map's profile
+    bool mAdaptiveNoise = false;
+    float mAdaptiveWeight = 0.5f;
+
+    // Index into block_sizes / window_sizes.  The window applies at once,
+    // the block size on Start Reduction, which reopens the stream.
+    int mBlockSizeChoice = 5;
+    int mWindowSizeChoice = 2;
+
+    // In the order of ResamplerQuality; used when the devices do not run
+    // at 48 kHz, and applied on Start Reduction like the block size
+    int mResamplerChoice = 0;
+
+    static constexpr int block_sizes[] = { 64, 128, 256, 512, 1024, 2048, 4096 };
+    static constexpr int window_sizes[] = { 512, 1024, 2048, 4096 };
+
+    int BlockSize() const { return block_sizes[mBlockSizeChoice]; }
+    // In the form of NoiseReduction::Settings::mWindowSizeChoice
+    int WindowSizeChoice() const { return 6 + mWindowSizeChoice; }
+
+    size_t latencySamples = 0;
+    float latencyMs = 0.0f;
+    double deviceRate = 0.0;
+    bool resampling = false;
+
+    const char* fftKernel = "";
+    size_t fftPlans = 0;
+    unsigned long long fftPlanHits = 0;
+    unsigned long long fftPlanMisses = 0;
     float mSilenceThresholdDB = -46.0f;
 
     bool reduction_started = false;
@@ -41,11 +41,14 @@
 
 #pragma once
 #include <vector>
+#include <cstdint>
 
 typedef std::vector<float> FloatVector;
-typedef __int64 sf_count_t;
+// Same as libsndfile's own typedef, so either header may come first
+typedef int64_t sf_count_t;
 
 #include <algorithm>
+#include <limits>
 
 #include <assert.h>
 
@@ -0,0 +1,85 @@
+#include "WavReader.h"
+
+#include <algorithm>
+#include <string.h>
+
+WavReader::WavReader(size_t chunkFrames)
+	: mChunkFrames(std::max<size_t>(chunkFrames, 1))
+{
+	memset(&mInfo, 0, sizeof(mInfo));
+}
+
+WavReader::~WavReader()
+{
+	Close();
+}
+
+bool WavReader::Open(const std::string& path)
+{
+	Close();
+
+	mFile = sf_open(path.c_str(), SFM_READ, &mInfo);
+	if (mFile == nullptr)
+	{
+		mError = sf_strerror(nullptr);
+		memset(&mInfo, 0, sizeof(mInfo));
+		return false;
+	}
+
+	mError.clear();
+	mPosition = 0;
+	return true;
+}
+
+void WavReader::Close()
+{
+	if (mFile != nullptr)
+	{
+		sf_close(mFile);
+		mFile = nullptr;
+	}
+	memset(&mInfo, 0, sizeof(mInfo));
+	mPosition = 0;
+}
+
+bool WavReader::Seek(int64_t frame)
+{
+	if (mFile == nullptr || sf_seek(mFile, frame, SEEK_SET) < 0)
+		return false;
+
+	mPosition = frame;
+	return true;
+}
+
+size_t WavReader::ReadInterleaved(float* interleaved, size_t frames)
+{
+	if (mFile == nullptr || frames == 0)
+		return 0;
+
+	const sf_count_t got = sf_readf_float(mFile, interleaved, (sf_count_t)frames);
+	if (got <= 0)
+		return 0;
+
+	mPosition += got;
+	return (size_t)got;
+}
+
+size_t WavReader::ReadPlanar(float* const* channels, size_t frames)
+{
+	// Kept across files of as many channels or fewer
+	if (mScratch.size() < mChunkFrames * Channels())
+		mScratch.resize(mChunkFrames * Channels());
+
+	const size_t got = ReadInterleaved(mScratch.data(), std::min(frames, mChunkFrames));
+	const size_t channelCount = Channels();
+
+	for (size_t cc = 0; cc < channelCount; ++cc)
+	{
+		const float* source = mScratch.data() + cc;
+		float* target = channels[cc];
+		for (size_t ii = 0; ii < got; ++ii)
+			target[ii] = source[ii * channelCount];
+	}
+
+	return got;
+}
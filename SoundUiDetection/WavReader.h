@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <sndfile.h>
+
+#include "Types.h"
+
+// Streams a sound file in chunks of at most ChunkFrames() frames, of any
+// channel count, into buffers the caller keeps and reuses.  Interleaved
+// chunks are decoded straight into the caller's buffer; planar chunks are
+// decoded into one chunk of scratch and spread over the channels, the only
+// copy.  Memory is the scratch chunk whatever the length of the file.
+class WavReader
+{
+public:
+	static constexpr size_t DEFAULT_CHUNK_FRAMES = 16384;
+
+	explicit WavReader(size_t chunkFrames = DEFAULT_CHUNK_FRAMES);
+	~WavReader();
+
+	WavReader(const WavReader&) = delete;
+	WavReader& operator=(const WavReader&) = delete;
+
+	// Closes the file open before, if any; false when path cannot be read,
+	// with the reason in Error()
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen() const { return mFile != nullptr; }
+	const std::string& Error() const { return mError; }
+
+	size_t Channels() const { return (size_t)mInfo.channels; }
+	int64_t Frames() const { return mInfo.frames; }
+	int Rate() const { return mInfo.samplerate; }
+	size_t ChunkFrames() const { return mChunkFrames; }
+
+	// Next frame to read, from 0
+	int64_t Position() const { return mPosition; }
+	bool Seek(int64_t frame);
+
+	// Up to frames frames, Channels() samples each, into interleaved; the
+	// frames read, 0 at the end of the file
+	size_t ReadInterleaved(float* interleaved, size_t frames);
+
+	// Up to ChunkFrames() frames, one buffer per channel; the frames read,
+	// 0 at the end of the file
+	size_t ReadPlanar(float* const* channels, size_t frames);
+
+private:
+	const size_t mChunkFrames;
+	SNDFILE* mFile = nullptr;
+	SF_INFO mInfo;
+	int64_t mPosition = 0;
+	std::string mError;
+
+	// Interleaved decode of a planar read; sized by the first one
+	FloatVector mScratch;
+};
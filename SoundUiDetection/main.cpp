@@ -1,6 +1,7 @@
 #include "SoundUi.h"
 #include "AudioStream.h"
 #include "NoiseReduction.h"
+#include "RealFFTf.h"
 #include <iostream>
 #include <chrono>
 
@@ -8,7 +9,6 @@ int main(int argc, char** argv)
 {
 	SoundWindow* uiWindow = nullptr;
 	AudioStream* audioStream = nullptr;
-	NoiseReduction* reductionObj = nullptr;
 
 	float SAMPLE_RATE = 48000;
 
@@ -16,38 +16,49 @@ int main(int argc, char** argv)
 
 	while (!glfwWindowShouldClose(uiWindow->window))
 	{
+		NoiseReduction::Settings settings;
+
+		settings.mNewSensitivity = uiWindow->mNewSensitivity;
+		settings.mFreqSmoothingBands = uiWindow->mFreqSmoothingBands;
+		settings.mNoiseGain = uiWindow->mNoiseGain;
+		settings.mWindowSizeChoice = uiWindow->WindowSizeChoice();
+		settings.mLinkChannels = uiWindow->mLinkChannels;
+		settings.mParallelChannels = uiWindow->mParallelChannels;
+		settings.mAdaptiveNoise = uiWindow->mAdaptiveNoise;
+		settings.mAdaptiveWeight = uiWindow->mAdaptiveWeight;
+
 		if (uiWindow->redution_button_start)
 		{
-			NoiseReduction::Settings settings;
+			// Only a new block size or resampler reopens the devices; scenes
+			// and settings are taken up by the running stream
+			const ResamplerQuality resamplerQuality = (ResamplerQuality)uiWindow->mResamplerChoice;
 
-			settings.mNewSensitivity = uiWindow->mNewSensitivity;
-			settings.mFreqSmoothingBands = uiWindow->mFreqSmoothingBands;
-			settings.mNoiseGain = uiWindow->mNoiseGain;
-
-			reductionObj = new NoiseReduction(settings, SAMPLE_RATE);
+			if (audioStream != nullptr && (audioStream->BlockSize() != (unsigned long)uiWindow->BlockSize() ||
+				audioStream->ResamplerQualityChoice() != resamplerQuality))
+			{
+				delete audioStream;
+				audioStream = nullptr;
+			}
 
-			std::cout << "Settings imported" << std::endl;
+			if (audioStream == nullptr)
+			{
+				audioStream = new AudioStream(SAMPLE_RATE, uiWindow->BlockSize(), resamplerQuality);
 
-			audioStream = new AudioStream(reductionObj, SAMPLE_RATE);
+				if (!audioStream->initStreamObj() || !audioStream->openStream() || !audioStream->startStream())
+				{
+					return 1;
+				}
 
-			if (!audioStream->initStreamObj() || !audioStream->openStream() || !audioStream->startStream())
-			{
-				return 1;
+				std::cout << "Audio Stream Started" << std::endl;
 			}
 
-			std::cout << "Audio Stream Started" << std::endl;
-
 			uiWindow->redution_button_start = false;
 		}
 
 		if (uiWindow->reduction_reseted)
 		{
-			delete reductionObj;
-			reductionObj = nullptr;
-
-			delete audioStream;
-			audioStream = nullptr;
-
+			// The stream keeps running and passes the audio through until
+			// a scene is chosen and started again
 			for (auto& map : uiWindow->tarkov_maps)
 			{
 				map.second = false;
@@ -59,17 +70,35 @@ int main(int argc, char** argv)
 			uiWindow->noiceAngle = 0.0f;
 
 			uiWindow->reduction_reseted = false;
-			uiWindow->redution_button_start = true;
 
 			std::cout.flush();
 		}
 
-		uiWindow->Run();
-
 		if (audioStream != nullptr)
 		{
-			audioStream->AudioProcessing(uiWindow->noiceAngle, uiWindow->mChunkSize, uiWindow->mSilenceThresholdDB, uiWindow->tarkov_maps, uiWindow->reduction_started);
+			// The audio thread runs on its own; the UI only exchanges atomics with
+			// it, and a new scene or new settings crossfade in without a dropout
+			audioStream->SetControls(uiWindow->mChunkSize, uiWindow->mSilenceThresholdDB, uiWindow->tarkov_maps, uiWindow->reduction_started, settings);
+
+			uiWindow->noiceAngle = audioStream->NeedleAngle();
+			uiWindow->leftLevel = audioStream->LeftLevel();
+			uiWindow->rightLevel = audioStream->RightLevel();
+			uiWindow->overruns = audioStream->CaptureOverruns();
+			uiWindow->underruns = audioStream->PlaybackUnderruns();
+			uiWindow->latencySamples = audioStream->LatencySamples();
+			uiWindow->latencyMs = audioStream->LatencyMs();
+			uiWindow->deviceRate = audioStream->DeviceRate();
+			uiWindow->resampling = audioStream->Resampling();
+			uiWindow->hotPathAllocations = audioStream->HotPathAllocations();
 		}
+
+		const FFTCacheStats fftStats = GetFFTCacheStats();
+		uiWindow->fftKernel = FFTKernelName(GetFFTKernel());
+		uiWindow->fftPlans = fftStats.plans;
+		uiWindow->fftPlanHits = fftStats.hits;
+		uiWindow->fftPlanMisses = fftStats.misses;
+
+		uiWindow->Run();
 	}
 
 	return 0;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "DspMath.h"
+
 class BoringFunc {
 public:
 	void addHashesBelow(const std::string& input)
@@ -51,69 +53,46 @@ public:
 		}
 	}
 
+	float calculateRMS(const std::vector<float>& buffer) {
+		return calculateRMS(buffer.data(), buffer.size());
+	}
+
 	/// <summary>
-	/// What the name says get the filename path and read the wav into a float* buffer
+	/// RMS over count samples taken every stride floats, so one channel of an interleaved buffer can be measured in place
 	/// </summary>
-	/// <param name="filename"></param>
-	/// <param name="frames"></param>
-	/// <returns>float* buffer</returns>
-
-	float* load_wav(const char* filename, sf_count_t& frames) {
-
-		SF_INFO sfinfo;
-
-		SNDFILE* sndfile = sf_open(filename, SFM_READ, &sfinfo);
-		if (sndfile == NULL) {
-			std::cerr << "Failed to open file: " << filename << std::endl;
-			return nullptr;
-		}
-
-		frames = sfinfo.frames;
-
-		float* buffer = (float*)malloc(frames * 2 * sizeof(float));
-		if (buffer == NULL) {
-			std::cerr << "Failed to allocate memory for the audio buffer." << std::endl;
-			sf_close(sndfile);
-			return nullptr;
+	float calculateRMS(const float* samples, size_t count, size_t stride = 1) {
+		float sum_of_squares = 0.0f;
+		for (size_t i = 0; i < count; ++i) {
+			sum_of_squares += samples[i * stride] * samples[i * stride];
 		}
-
-		sf_count_t num_samples = sf_readf_float(sndfile, buffer, frames);
-
-		if (num_samples != frames) {
-			std::cerr << "Did not read expected amount of frames." << std::endl;
-			free(buffer);
-			sf_close(sndfile);
-			return nullptr;
-		}
-
-		sf_close(sndfile);
-		return buffer;
+		return std::sqrt(sum_of_squares / count);
 	}
 
-	InputTrack copyBufferToVector(const float* paBuffer, unsigned long buffersize)
+	float calculateNeedleAngle(const std::vector<float>& leftChannel, const std::vector<float>& rightChannel)
 	{
-		std::vector<float> outputVector(buffersize * 2);
-		std::copy(paBuffer, paBuffer + buffersize * 2, outputVector.begin());
-
-		return InputTrack(outputVector);
-	}
+		if (leftChannel.empty() || rightChannel.empty())
+		{
+			return 0.0f;
+		}
 
-	float calculateRMS(const std::vector<float>& buffer) {
-		float sum_of_squares = std::accumulate(buffer.begin(), buffer.end(), 0.0f,
-			[](float sum, float value) { return sum + value * value; });
-		return std::sqrt(sum_of_squares / buffer.size());
+		return needleAngleFromRMS(calculateRMS(leftChannel), calculateRMS(rightChannel));
 	}
 
-	float calculateNeedleAngle(const std::vector<float>& leftChannel, const std::vector<float>& rightChannel)
+	/// <summary>
+	/// Same as above, straight from an interleaved stereo buffer without splitting it
+	/// </summary>
+	float calculateNeedleAngle(const float* interleaved, size_t frames)
 	{
-		if (leftChannel.empty() || rightChannel.empty())
+		if (frames == 0)
 		{
 			return 0.0f;
 		}
 
-		float leftRMS = calculateRMS(leftChannel);
-		float rightRMS = calculateRMS(rightChannel);
+		return needleAngleFromRMS(calculateRMS(interleaved, frames, 2), calculateRMS(interleaved + 1, frames, 2));
+	}
 
+	float needleAngleFromRMS(float leftRMS, float rightRMS)
+	{
 		float sumRMS = leftRMS + rightRMS;
 
 		if (sumRMS == 0.0f)
@@ -133,43 +112,53 @@ public:
 	}
 
 	float calculateChunkMaxDB(const std::vector<float>& chunk) {
-		if (chunk.empty()) {
+		return calculateChunkMaxDB(chunk.data(), chunk.size());
+	}
+
+	float calculateChunkMaxDB(const float* chunk, size_t size) {
+		if (size == 0) {
 			return -std::numeric_limits<float>::infinity();
 		}
 
-		float peakAmplitude = *std::max_element(chunk.begin(), chunk.end(),
-			[](float a, float b) { return std::fabs(a) < std::fabs(b); });
+		float peakAmplitude = 0.0f;
+		for (size_t i = 0; i < size; ++i) {
+			peakAmplitude = std::max(peakAmplitude, std::fabs(chunk[i]));
+		}
 
-		float maxDB = 20.0f * std::log10(std::fabs(peakAmplitude));
+		// Digital silence stays below any threshold
+		if (peakAmplitude == 0.0f) {
+			return -std::numeric_limits<float>::infinity();
+		}
 
-		return maxDB;
+		return DspMath::LinearToDb(peakAmplitude);
 	}
 
 	void processBuffer(std::vector<float>& buffer, size_t chunkSize = 512, float silenceThresholdDB = -46.0f) {
-		if (buffer.empty() || chunkSize == 0) {
+		processBuffer(buffer.data(), buffer.size(), chunkSize, silenceThresholdDB);
+	}
+
+	/// <summary>
+	/// Silence gate: zero the whole buffer when the mean of its per-chunk peak levels is below the threshold.
+	/// Works in place and allocates nothing, so it is safe on the audio thread.
+	/// </summary>
+	void processBuffer(float* buffer, size_t size, size_t chunkSize = 512, float silenceThresholdDB = -46.0f) {
+		if (size == 0 || chunkSize == 0) {
 			return;
 		}
 
 		//const float silenceThresholdLinear = std::pow(10.0f, silenceThresholdDB / 20.0f);
 
-		size_t numChunks = (buffer.size() + chunkSize - 1) / chunkSize;
-		std::vector<float> maxDBs(numChunks);
-
-		std::for_each(std::execution::par, maxDBs.begin(), maxDBs.end(), [&](float& chunkMaxDB) {
-			size_t chunkIndex = &chunkMaxDB - maxDBs.data();
-			size_t start = chunkIndex * chunkSize;
+		size_t numChunks = (size + chunkSize - 1) / chunkSize;
+		float sumMaxDB = 0.0f;
 
-			std::vector<float> chunk(buffer.begin() + start, buffer.begin() + std::min(start + chunkSize, buffer.size()));
-
-			chunkMaxDB = calculateChunkMaxDB(chunk);
-			});
+		for (size_t start = 0; start < size; start += chunkSize) {
+			sumMaxDB += calculateChunkMaxDB(buffer + start, std::min(chunkSize, size - start));
+		}
 
-		float meanMaxDB = std::accumulate(maxDBs.begin(), maxDBs.end(), 0.0f) / maxDBs.size();
+		float meanMaxDB = sumMaxDB / numChunks;
 
 		if (meanMaxDB < silenceThresholdDB) {
-			std::for_each(std::execution::par, buffer.begin(), buffer.end(), [](float& sample) {
-				sample = 0.0f;
-				});
+			std::fill(buffer, buffer + size, 0.0f);
 		}
 	}
 